@@ -18,6 +18,7 @@
 
 #include "ad/cppgtfs/Parser.h"
 #include "ad/cppgtfs/Writer.h"
+#include "pfaedle/ThreadPool.h"
 #include "pfaedle/config/ConfigReader.h"
 #include "pfaedle/config/MotConfig.h"
 #include "pfaedle/config/MotConfigReader.h"
@@ -25,9 +26,11 @@
 #include "pfaedle/gtfs/Writer.h"
 #include "pfaedle/netgraph/Graph.h"
 #include "pfaedle/osm/OsmIdSet.h"
+#include "pfaedle/router/ContractionHierarchy.h"
 #include "pfaedle/router/ShapeBuilder.h"
 #include "pfaedle/router/Stats.h"
 #include "pfaedle/statsimi-classifier/StatsimiClassifier.h"
+#include "pfaedle/trgraph/CSRGraph.h"
 #include "pfaedle/trgraph/Graph.h"
 #include "util/Misc.h"
 #include "util/geo/output/GeoGraphJsonOutput.h"
@@ -52,6 +55,7 @@ using pfaedle::config::MotConfig;
 using pfaedle::config::MotConfigReader;
 using pfaedle::osm::BBoxIdx;
 using pfaedle::osm::OsmBuilder;
+using pfaedle::router::ContractionHierarchy;
 using pfaedle::router::DistDiffTransWeight;
 using pfaedle::router::DistDiffTransWeightNoHeur;
 using pfaedle::router::ExpoTransWeight;
@@ -136,6 +140,9 @@ int main(int argc, char** argv) {
     exit(static_cast<int>(RetCode::NO_MOT_CFG));
   }
 
+  // all parallel stages share this pool
+  pfaedle::ThreadPool pool(cfg.numThreads, cfg.pinThreads);
+
   T_START(gtfsBuild);
 
   if (cfg.feedPaths.size() == 1) {
@@ -276,7 +283,13 @@ int main(int argc, char** argv) {
 
       pfaedle::osm::Restrictor restr;
       pfaedle::trgraph::Graph graph;
-      pfaedle::osm::OsmBuilder osmBuilder;
+      pfaedle::osm::OsmIngestOpts ingestOpts;
+      ingestOpts.singlePass = cfg.osmSinglePass;
+      ingestOpts.memIdSet = cfg.osmMemIdSet;
+      ingestOpts.sortMem = cfg.osmSortMem;
+      ingestOpts.graphCacheDir = cfg.osmGraphCache;
+      ingestOpts.pool = &pool;
+      pfaedle::osm::OsmBuilder osmBuilder(ingestOpts);
 
       pfaedle::osm::BBoxIdx box(cfg.boxPadding);
       ShapeBuilder::getGtfsBox(
@@ -296,6 +309,19 @@ int main(int argc, char** argv) {
         graphDimensions[filePost].second += nd->getAdjListOut().size();
       }
 
+      // the graph is not changed anymore from here on
+      pfaedle::trgraph::CSRGraph csrGraph(graph);
+
+      ContractionHierarchy* ch = 0;
+
+      if (cfg.hopCH) {
+        LOG(INFO) << "Building contraction hierarchy...";
+        T_START(chBuild);
+        ch = new ContractionHierarchy(csrGraph, motCfg.routingOpts, restr);
+        LOG(INFO) << "Done, added " << ch->getNumShortcuts()
+                  << " shortcuts (" << T_STOP(chBuild) << " ms)";
+      }
+
       StatsimiClassifier* statsimiClassifier;
 
       if (motCfg.routingOpts.statsimiMethod == "bts") {
@@ -318,19 +344,19 @@ int main(int argc, char** argv) {
 
       if (motCfg.routingOpts.transPenMethod == "exp") {
         if (cfg.noAStar)
-          router = new RouterImpl<ExpoTransWeightNoHeur>();
+          router = new RouterImpl<ExpoTransWeightNoHeur>(&csrGraph, ch);
         else
-          router = new RouterImpl<ExpoTransWeight>();
+          router = new RouterImpl<ExpoTransWeight>(&csrGraph, ch);
       } else if (motCfg.routingOpts.transPenMethod == "distdiff") {
         if (cfg.noAStar)
-          router = new RouterImpl<DistDiffTransWeightNoHeur>();
+          router = new RouterImpl<DistDiffTransWeightNoHeur>(&csrGraph, ch);
         else
-          router = new RouterImpl<DistDiffTransWeight>();
+          router = new RouterImpl<DistDiffTransWeight>(&csrGraph, ch);
       } else if (motCfg.routingOpts.transPenMethod == "timenorm") {
         if (cfg.noAStar)
-          router = new RouterImpl<NormDistrTransWeightNoHeur>();
+          router = new RouterImpl<NormDistrTransWeightNoHeur>(&csrGraph, ch);
         else
-          router = new RouterImpl<NormDistrTransWeight>();
+          router = new RouterImpl<NormDistrTransWeight>(&csrGraph, ch);
       } else {
         LOG(ERROR) << "Unknown routing method "
                    << motCfg.routingOpts.transPenMethod;
@@ -338,7 +364,8 @@ int main(int argc, char** argv) {
       }
 
       ShapeBuilder shapeBuilder(&gtfs[0], usedMots, motCfg, &graph, &fStops,
-                                &restr, statsimiClassifier, router, cfg);
+                                &restr, statsimiClassifier, router, cfg,
+                                &pool);
 
       pfaedle::netgraph::Graph ng;
 
@@ -361,6 +388,7 @@ int main(int argc, char** argv) {
       }
 
       if (router) delete router;
+      if (ch) delete ch;
       if (statsimiClassifier) delete statsimiClassifier;
 
       if (cfg.writeGraph) {
@@ -421,6 +449,22 @@ int main(int argc, char** argv) {
              {"num_tries", stats.numTries},
              {"num_trie_leafs", stats.numTrieLeafs},
              {"dijkstra_iters", stats.dijkstraIters},
+             {"hop_cache_lookups", stats.hopCacheLookups},
+             {"hop_cache_hits", stats.hopCacheHits},
+             {"hop_cache_hit_rate",
+              stats.hopCacheLookups
+                  ? stats.hopCacheHits / (stats.hopCacheLookups * 1.0)
+                  : 0.0},
+             {"shared_hop_cache_lookups", stats.sharedHopCacheLookups},
+             {"shared_hop_cache_hits", stats.sharedHopCacheHits},
+             {"shared_hop_cache_hit_rate",
+              stats.sharedHopCacheLookups
+                  ? stats.sharedHopCacheHits /
+                        (stats.sharedHopCacheLookups * 1.0)
+                  : 0.0},
+             {"hop_cache_contended", stats.hopCacheContended},
+             {"beam_pruned_cands", stats.beamPruned},
+             {"beam_uncertain_leafs", stats.beamUncertain},
              {"time_solve", stats.solveTime},
              {"time_read_osm", tOsmBuild},
              {"time_read_gtfs", static_cast<int>(tGtfsBuild)},
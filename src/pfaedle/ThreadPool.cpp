@@ -0,0 +1,166 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "pfaedle/ThreadPool.h"
+#include "util/Misc.h"
+#include "util/log/Log.h"
+
+using pfaedle::ThreadPool;
+
+// _____________________________________________________________________________
+ThreadPool::ThreadPool(size_t numThreads) : ThreadPool(numThreads, false) {}
+
+// _____________________________________________________________________________
+ThreadPool::ThreadPool(size_t numThreads, bool pin)
+    : _numThreads(numThreads), _stop(false) {
+  if (_numThreads == 0) _numThreads = getNumCpus();
+  if (_numThreads == 0) _numThreads = 1;
+
+  std::vector<int> cpus;
+  if (pin) cpus = getCpus();
+
+  // the calling thread keeps cpus[0] to itself, but is not pinned to it
+  for (size_t i = 1; i < _numThreads; i++) {
+    _workers.emplace_back([this, cpus, i]() {
+      if (cpus.size()) ThreadPool::pin(cpus[i % cpus.size()]);
+      work();
+    });
+  }
+
+  LOG(DEBUG) << "Started thread pool with " << _numThreads << " threads"
+             << (pin ? ", pinned to CPUs" : "");
+}
+
+// _____________________________________________________________________________
+ThreadPool* ThreadPool::getOrTmp(ThreadPool* pool,
+                                 std::unique_ptr<ThreadPool>* tmp) {
+  if (pool) return pool;
+  tmp->reset(new ThreadPool(0));
+  return tmp->get();
+}
+
+// _____________________________________________________________________________
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_m);
+    _stop = true;
+  }
+  _cv.notify_all();
+
+  for (auto& t : _workers) t.join();
+}
+
+// _____________________________________________________________________________
+void ThreadPool::run(size_t n, const std::function<void(size_t)>& f) {
+  if (n == 0) return;
+
+  Group g{n, std::exception_ptr()};
+
+  {
+    std::lock_guard<std::mutex> lock(_m);
+    for (size_t i = 0; i < n; i++) _tasks.push_back({&f, i, &g});
+  }
+  _cv.notify_all();
+
+  // help with pending tasks until the group is finished
+  std::unique_lock<std::mutex> lock(_m);
+  while (g.left) {
+    if (_tasks.empty()) {
+      _cv.wait(lock);
+      continue;
+    }
+
+    Task t = _tasks.front();
+    _tasks.pop_front();
+    lock.unlock();
+    exec(t);
+    lock.lock();
+  }
+
+  if (g.err) std::rethrow_exception(g.err);
+}
+
+// _____________________________________________________________________________
+void ThreadPool::work() {
+  std::unique_lock<std::mutex> lock(_m);
+  while (true) {
+    _cv.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+    if (_tasks.empty()) return;
+
+    Task t = _tasks.front();
+    _tasks.pop_front();
+    lock.unlock();
+    exec(t);
+    lock.lock();
+  }
+}
+
+// _____________________________________________________________________________
+void ThreadPool::exec(const Task& t) {
+  std::exception_ptr err;
+
+  try {
+    (*t.f)(t.i);
+  } catch (...) {
+    err = std::current_exception();
+  }
+
+  std::lock_guard<std::mutex> lock(_m);
+  if (err && !t.g->err) t.g->err = err;
+
+  // wake up the thread waiting for this group
+  if (--t.g->left == 0) _cv.notify_all();
+}
+
+// _____________________________________________________________________________
+std::vector<int> ThreadPool::getCpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  // only use CPUs we are allowed to run on, e.g. inside a cgroup
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return cpus;
+
+  for (int c = 0; c < CPU_SETSIZE; c++) {
+    if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+  }
+#else
+  LOG(WARN) << "Pinning threads to CPUs is not supported on this platform";
+#endif
+  return cpus;
+}
+
+// _____________________________________________________________________________
+size_t ThreadPool::getNumCpus() {
+#ifdef __linux__
+  // respect the affinity mask, e.g. of a cpuset cgroup
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    return CPU_COUNT(&allowed);
+  }
+#endif
+  return std::thread::hardware_concurrency();
+}
+
+// _____________________________________________________________________________
+void ThreadPool::pin(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    LOG(WARN) << "Could not pin thread to CPU " << cpu;
+  }
+#else
+  UNUSED(cpu);
+#endif
+}
@@ -0,0 +1,82 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_THREADPOOL_H_
+#define PFAEDLE_THREADPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pfaedle {
+
+/*
+ * Fixed-size pool of worker threads shared by all parallel stages. A pool
+ * of n threads starts n - 1 workers, the thread waiting in run() is the
+ * n-th one and executes pending tasks itself. This also makes it safe to
+ * call run() from within a task.
+ */
+class ThreadPool {
+ public:
+  // Pool of numThreads threads, 0 means one per CPU this process may run on
+  explicit ThreadPool(size_t numThreads);
+
+  // Same as above, if pin is true, each worker thread is bound to its own
+  // CPU out of the CPUs this process may run on. The calling thread is left
+  // unpinned, as threads started by it later on inherit its affinity
+  ThreadPool(size_t numThreads, bool pin);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t getNumThreads() const { return _numThreads; }
+
+  // Run f(i) for each i in [0, n) and wait until all calls are finished.
+  // The first exception thrown by f is rethrown
+  void run(size_t n, const std::function<void(size_t)>& f);
+
+  // Number of CPUs this process may run on
+  static size_t getNumCpus();
+
+  // Return pool, or if it is null, a temporary pool with a thread per CPU
+  // which is owned by tmp
+  static ThreadPool* getOrTmp(ThreadPool* pool,
+                              std::unique_ptr<ThreadPool>* tmp);
+
+ private:
+  struct Group {
+    size_t left;
+    std::exception_ptr err;
+  };
+
+  struct Task {
+    const std::function<void(size_t)>* f;
+    size_t i;
+    Group* g;
+  };
+
+  size_t _numThreads;
+  std::vector<std::thread> _workers;
+
+  std::deque<Task> _tasks;
+  std::mutex _m;
+  std::condition_variable _cv;
+  bool _stop;
+
+  void work();
+  void exec(const Task& t);
+
+  static std::vector<int> getCpus();
+  static void pin(int cpu);
+};
+
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_THREADPOOL_H_
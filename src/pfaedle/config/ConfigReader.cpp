@@ -2,8 +2,11 @@
 // Chair of Algorithms and Data Structures.
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
+#include <errno.h>
 #include <float.h>
 #include <getopt.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <exception>
 #include <iostream>
 #include <string>
@@ -46,6 +49,10 @@ void ConfigReader::help(const char* bin) {
             << "  recalculate them\n"
             << std::setw(35) << "  --write-colors"
             << "write matched route line colors, where missing\n"
+            << std::setw(35) << "  -j [ --threads ] arg (=0)"
+            << "number of threads, 0 for one per available CPU core\n"
+            << std::setw(35) << "  --pin-threads"
+            << "pin each thread to its own CPU core\n"
             << "\nInput:\n"
             << std::setw(35) << "  -c [ --config ] arg"
             << "pfaedle config file\n"
@@ -113,6 +120,30 @@ void ConfigReader::help(const char* bin) {
             << "Disable trip tries \n"
             << std::setw(35) << "  --no-hop-cache"
             << "Disable hop cache \n"
+            << std::setw(35) << "  --osm-single-pass"
+            << "Read OSM file in a single pass, buffering\n"
+            << std::setw(35) << " "
+            << "  the needed entities in memory\n"
+            << std::setw(35) << "  --osm-mem-idset"
+            << "Keep OSM id sets in memory instead of on disk\n"
+            << std::setw(35) << "  --osm-sort-mem arg (=256)"
+            << "Memory budget in MB for sorting on-disk\n"
+            << std::setw(35) << " "
+            << "  OSM id sets\n"
+            << std::setw(35) << "  --osm-graph-cache arg"
+            << "Directory for graph snapshots, reused if\n"
+            << std::setw(35) << " "
+            << "  OSM file and options did not change\n"
+            << std::setw(35) << "  --hop-ch"
+            << "Precompute a contraction hierarchy for\n"
+            << std::setw(35) << " "
+            << "  hop routing\n"
+            << std::setw(35) << "  --parallel-hops"
+            << "Route the sources of a hop concurrently\n"
+            << std::setw(35) << "  --beam-width arg (=0)"
+            << "Only route from the <arg> cheapest candidates\n"
+            << std::setw(35) << " "
+            << "  of each stop, 0 for all\n"
             << std::setw(35) << "  --stats"
             << "write stats to stats.json\n"
             << std::setw(35) << "  -W [ --warn ]"
@@ -151,13 +182,22 @@ void ConfigReader::read(Config* cfg, int argc, char** argv) {
                          {"stats", no_argument, 0, 14},
                          {"no-hop-cache", no_argument, 0, 15},
                          {"gaussian-noise", required_argument, 0, 16},
+                         {"osm-single-pass", no_argument, 0, 17},
+                         {"osm-mem-idset", no_argument, 0, 18},
+                         {"osm-sort-mem", required_argument, 0, 19},
+                         {"osm-graph-cache", required_argument, 0, 20},
+                         {"hop-ch", no_argument, 0, 21},
+                         {"threads", required_argument, 0, 'j'},
+                         {"pin-threads", no_argument, 0, 22},
+                         {"parallel-hops", no_argument, 0, 23},
+                         {"beam-width", required_argument, 0, 24},
                          {"warn", no_argument, 0, 'W'},
                          {"keep-additional-gtfs-fields", no_argument, 0, 'F'},
                          {0, 0, 0, 0}};
 
   int c;
-  while ((c = getopt_long(argc, argv, ":o:hvi:c:x:Dm:g:X:T:d:pP:FWb:", ops, 0)) !=
-         -1) {
+  while ((c = getopt_long(argc, argv, ":o:hvi:c:x:Dm:g:X:T:d:pP:FWb:j:", ops,
+                          0)) != -1) {
     switch (c) {
       case 1:
         cfg->writeGraph = true;
@@ -231,6 +271,43 @@ void ConfigReader::read(Config* cfg, int argc, char** argv) {
       case 16:
         cfg->gaussianNoise = atof(optarg);
         break;
+      case 17:
+        cfg->osmSinglePass = true;
+        break;
+      case 18:
+        cfg->osmMemIdSet = true;
+        break;
+      case 19:
+        cfg->osmSortMem = atof(optarg) * 1024 * 1024;
+        break;
+      case 20:
+        cfg->osmGraphCache = optarg;
+        break;
+      case 21:
+        cfg->hopCH = true;
+        break;
+      case 'j': {
+        char* end;
+        errno = 0;
+        const long n = strtol(optarg, &end, 10);
+        if (end == optarg || *end != 0 || errno == ERANGE || n < 0 ||
+            n > INT_MAX) {
+          std::cerr << "Error: number of threads must be a non-negative "
+                       "integer, got \"" << optarg << "\"" << std::endl;
+          exit(1);
+        }
+        cfg->numThreads = n;
+        break;
+      }
+      case 22:
+        cfg->pinThreads = true;
+        break;
+      case 23:
+        cfg->parallelHops = true;
+        break;
+      case 24:
+        cfg->beamWidth = atoi(optarg);
+        break;
       case 'W':
         cfg->verbosity = 1;
         break;
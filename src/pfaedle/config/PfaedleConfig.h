@@ -38,6 +38,14 @@ struct Config {
         noHopCache(false),
         writeStats(false),
         parseAdditionalGTFSFields(false),
+        osmSinglePass(false),
+        osmMemIdSet(false),
+        osmSortMem(256 * 1024 * 1024),
+        hopCH(false),
+        parallelHops(false),
+        beamWidth(0),
+        numThreads(0),
+        pinThreads(false),
         gridSize(2000 / util::geo::M_PER_DEG),
         boxPadding(20000),
         gaussianNoise(0),
@@ -67,6 +75,15 @@ struct Config {
   bool noHopCache;
   bool writeStats;
   bool parseAdditionalGTFSFields;
+  bool osmSinglePass;
+  bool osmMemIdSet;
+  size_t osmSortMem;
+  std::string osmGraphCache;
+  bool hopCH;
+  bool parallelHops;
+  size_t beamWidth;
+  size_t numThreads;
+  bool pinThreads;
   double gridSize;
   double boxPadding;
   double gaussianNoise;
@@ -96,6 +113,15 @@ struct Config {
        << "verbosity: " << verbosity << "\n"
        << "parse-additional-gtfs-fields: " << parseAdditionalGTFSFields << "\n"
        << "write-stats: " << writeStats << "\n"
+       << "osm-single-pass: " << osmSinglePass << "\n"
+       << "osm-mem-idset: " << osmMemIdSet << "\n"
+       << "osm-sort-mem: " << osmSortMem << "\n"
+       << "osm-graph-cache: " << osmGraphCache << "\n"
+       << "hop-ch: " << hopCH << "\n"
+       << "parallel-hops: " << parallelHops << "\n"
+       << "beam-width: " << beamWidth << "\n"
+       << "threads: " << numThreads << "\n"
+       << "pin-threads: " << pinThreads << "\n"
        << "feed-paths: ";
 
     for (const auto& p : feedPaths) {
@@ -0,0 +1,130 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#include <cassert>
+#include <vector>
+#include "pfaedle/osm/EliasFano.h"
+
+using pfaedle::osm::EliasFano;
+
+// _____________________________________________________________________________
+EliasFano::EliasFano(const uint64_t* beg, const uint64_t* end)
+    : _first(*beg), _last(*(end - 1)), _n(end - beg), _l(0) {
+  assert(beg < end);
+
+  uint64_t u = _last - _first;
+
+  // number of lower bits is floor(log2(u / n))
+  uint64_t q = u / _n;
+  while ((q >> _l) > 1) _l++;
+
+  size_t hLen = _n + (u >> _l) + 1;
+
+  _low.resize((_n * _l + 63) / 64 + 1, 0);
+  _high.resize((hLen + 63) / 64, 0);
+
+  for (size_t i = 0; i < _n; i++) {
+    uint64_t x = beg[i] - _first;
+    assert(i == 0 || beg[i] > beg[i - 1]);
+
+    if (_l) {
+      uint64_t lowBits = x & ((uint64_t(1) << _l) - 1);
+      size_t bit = i * _l;
+      _low[bit / 64] |= lowBits << (bit % 64);
+      if (bit % 64 + _l > 64) _low[bit / 64 + 1] |= lowBits >> (64 - bit % 64);
+    }
+
+    size_t pos = (x >> _l) + i;
+    _high[pos / 64] |= uint64_t(1) << (pos % 64);
+  }
+
+  size_t zeros = 0;
+  for (size_t pos = 0; pos < hLen; pos++) {
+    if (_high[pos / 64] & (uint64_t(1) << (pos % 64))) continue;
+    if (zeros % ZERO_SAMPLE == 0) _zeroSamples.push_back(pos);
+    zeros++;
+  }
+}
+
+// _____________________________________________________________________________
+uint64_t EliasFano::low(size_t i) const {
+  if (!_l) return 0;
+  size_t bit = i * _l;
+  uint64_t ret = _low[bit / 64] >> (bit % 64);
+  if (bit % 64 + _l > 64) ret |= _low[bit / 64 + 1] << (64 - bit % 64);
+  return ret & ((uint64_t(1) << _l) - 1);
+}
+
+// _____________________________________________________________________________
+size_t EliasFano::selectZero(size_t k) const {
+  size_t pos = _zeroSamples[k / ZERO_SAMPLE];
+  size_t rem = k % ZERO_SAMPLE;
+
+  if (!rem) return pos;
+
+  // zeros after pos in its word
+  size_t w = pos / 64;
+  uint64_t bits = ~_high[w] & (~uint64_t(0) << (pos % 64)) &
+                  ~(uint64_t(1) << (pos % 64));
+
+  while (true) {
+    size_t cnt = __builtin_popcountll(bits);
+    if (cnt >= rem) break;
+    rem -= cnt;
+    bits = ~_high[++w];
+  }
+
+  // drop the rem - 1 lowest zeros in this word
+  for (size_t i = 1; i < rem; i++) bits &= bits - 1;
+
+  return w * 64 + __builtin_ctzll(bits);
+}
+
+// _____________________________________________________________________________
+bool EliasFano::has(uint64_t v) const {
+  if (v < _first || v > _last) return false;
+
+  uint64_t x = v - _first;
+  uint64_t h = x >> _l;
+  uint64_t lowBits = _l ? x & ((uint64_t(1) << _l) - 1) : 0;
+
+  // the values with upper part h are between the (h-1)-th and the h-th zero
+  size_t start = h ? selectZero(h - 1) + 1 : 0;
+
+  size_t lo = start - h;
+  size_t hi = selectZero(h) - h;
+
+  // binary search on the lower bits, which are sorted within a bucket
+  while (lo < hi) {
+    size_t m = lo + (hi - lo) / 2;
+    uint64_t cur = low(m);
+    if (cur == lowBits) return true;
+    if (cur < lowBits)
+      lo = m + 1;
+    else
+      hi = m;
+  }
+
+  return false;
+}
+
+// _____________________________________________________________________________
+void EliasFano::decode(std::vector<uint64_t>* ret) const {
+  size_t i = 0;
+  for (size_t w = 0; w < _high.size() && i < _n; w++) {
+    uint64_t bits = _high[w];
+    while (bits) {
+      size_t pos = w * 64 + __builtin_ctzll(bits);
+      ret->push_back(_first + (((pos - i) << _l) | low(i)));
+      i++;
+      bits &= bits - 1;
+    }
+  }
+}
+
+// _____________________________________________________________________________
+size_t EliasFano::getMemSize() const {
+  return sizeof(*this) + _low.size() * sizeof(uint64_t) +
+         _high.size() * sizeof(uint64_t) +
+         _zeroSamples.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,62 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_OSM_ELIASFANO_H_
+#define PFAEDLE_OSM_ELIASFANO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace pfaedle {
+namespace osm {
+
+/*
+ * Static Elias-Fano encoding of a sorted, duplicate-free sequence of 64 bit
+ * integers. Each value takes roughly 2 + log2(universe / n) bits, membership
+ * checks are answered in memory in (nearly) constant time.
+ */
+class EliasFano {
+ public:
+  // Encode the sorted, duplicate-free values in [beg, end), which must not
+  // be empty
+  EliasFano(const uint64_t* beg, const uint64_t* end);
+
+  // Check if v is contained
+  bool has(uint64_t v) const;
+
+  // Append all encoded values to ret, in ascending order
+  void decode(std::vector<uint64_t>* ret) const;
+
+  uint64_t front() const { return _first; }
+  uint64_t back() const { return _last; }
+  size_t size() const { return _n; }
+
+  // Approximate memory consumption in bytes
+  size_t getMemSize() const;
+
+ private:
+  uint64_t _first;
+  uint64_t _last;
+  size_t _n;
+  uint8_t _l;
+
+  // the lower _l bits of each value, packed
+  std::vector<uint64_t> _low;
+
+  // the upper bits of each value, unary coded: value i sets bit
+  // (v_i >> _l) + i, so the number of zeros before it is its upper part
+  std::vector<uint64_t> _high;
+
+  // position in _high of every ZERO_SAMPLE-th zero
+  std::vector<uint32_t> _zeroSamples;
+
+  static const size_t ZERO_SAMPLE = 64;
+
+  uint64_t low(size_t i) const;
+  size_t selectZero(size_t k) const;
+};
+}  // namespace osm
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_OSM_ELIASFANO_H_
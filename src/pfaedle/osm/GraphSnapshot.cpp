@@ -0,0 +1,587 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "pfaedle/osm/GraphSnapshot.h"
+#include "util/log/Log.h"
+
+using pfaedle::osm::GraphSnapshot;
+using pfaedle::osm::Restrictor;
+using pfaedle::trgraph::Edge;
+using pfaedle::trgraph::Graph;
+using pfaedle::trgraph::Node;
+using pfaedle::trgraph::NodePL;
+using pfaedle::trgraph::StatInfo;
+using pfaedle::trgraph::TransitEdgeLine;
+
+static const char MAGIC[8] = {'P', 'F', 'D', 'L', 'G', 'R', 'P', 'H'};
+
+// station info markers of nodes
+static const uint8_t SI_NONE = 0;
+static const uint8_t SI_STAT = 1;
+static const uint8_t SI_BLOCKER = 2;
+static const uint8_t SI_TURNCYCLE = 3;
+
+static const uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+
+const uint32_t GraphSnapshot::VERSION;
+
+// _____________________________________________________________________________
+uint64_t GraphSnapshot::getKey(const std::string& osmPath,
+                               const OsmReadOpts& opts, const BBoxIdx& box,
+                               double gridSize) {
+  uint64_t h = 14695981039346656037ull;
+
+  hash(&h, &VERSION, sizeof(VERSION));
+
+  // snapshots are not portable between differently compiled binaries
+  uint32_t precSize = sizeof(PFDL_PREC);
+  hash(&h, &precSize, sizeof(precSize));
+#ifdef PFAEDLE_STATION_IDS
+  hash(&h, "ids", 3);
+#endif
+
+  hashFile(&h, osmPath);
+
+  hash(&h, opts.noHupFilter);
+  hash(&h, opts.keepFilter);
+  for (size_t i = 0; i < 8; i++) hash(&h, opts.levelFilters[i]);
+  hash(&h, opts.dropFilter);
+  hash(&h, opts.oneWayFilter);
+  hash(&h, opts.oneWayFilterRev);
+  hash(&h, opts.twoWayFilter);
+  hash(&h, opts.stationFilter);
+  hash(&h, opts.stationBlockerFilter);
+  hash(&h, opts.turnCycleFilter);
+
+  hash(&h, opts.statNormzer);
+  hash(&h, opts.lineNormzer);
+  hash(&h, opts.trackNormzer);
+  hash(&h, opts.idNormzer);
+
+  hash(&h, opts.relLinerules.sNameRule);
+  hash(&h, opts.relLinerules.fromNameRule);
+  hash(&h, opts.relLinerules.toNameRule);
+  hash(&h, opts.relLinerules.colorRule);
+
+  hash(&h, opts.statAttrRules.nameRule);
+  hash(&h, opts.statAttrRules.platformRule);
+  hash(&h, opts.statAttrRules.idRule);
+
+  hash(&h, opts.edgePlatformRules);
+
+  hash(&h, opts.maxSnapLevel);
+  hash(&h, opts.maxAngleSnapReach);
+  hash(&h, opts.maxSnapDistance);
+  hash(&h, opts.maxStationCandDistance);
+  hash(&h, opts.maxBlockDistance);
+  hash(&h, opts.maxSpeed);
+  hash(&h, opts.maxSpeedCorFac);
+  for (double d : opts.maxOsmStationDistances) hash(&h, d);
+  for (size_t i = 0; i < 8; i++) hash(&h, opts.levelDefSpeed[i]);
+  hash(&h, opts.oneWaySpeedPen);
+  hash(&h, opts.oneWayEntryCost);
+  hash(&h, opts.noLinesPunishFact);
+  hash(&h, opts.fullTurnAngle);
+
+  hash(&h, opts.restrPosRestr);
+  hash(&h, opts.restrNegRestr);
+  hash(&h, opts.noRestrFilter);
+
+  for (const auto& b : box.getLeafs()) {
+    hash(&h, b.getLowerLeft().getX());
+    hash(&h, b.getLowerLeft().getY());
+    hash(&h, b.getUpperRight().getX());
+    hash(&h, b.getUpperRight().getY());
+  }
+
+  hash(&h, gridSize);
+
+  return h;
+}
+
+// _____________________________________________________________________________
+std::string GraphSnapshot::getPath(const std::string& dir, uint64_t key) {
+  std::stringstream ss;
+  ss << dir << "/pfaedle-graph-" << std::hex << std::setw(16)
+     << std::setfill('0') << key << ".bin";
+  return ss.str();
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::write(const std::string& path, uint64_t key,
+                          const Graph& g, const Restrictor& res) {
+  // write to a temporary file first, so that concurrent runs never see a
+  // partial snapshot
+  std::string tmpPath = path + ".tmp";
+  std::ofstream o(tmpPath, std::ios::binary | std::ios::trunc);
+  if (!o.good()) {
+    LOG(WARN) << "Could not write graph snapshot to " << tmpPath;
+    return;
+  }
+
+  o.write(MAGIC, sizeof(MAGIC));
+  put(&o, VERSION);
+  put(&o, key);
+
+  // component table
+  put<uint64_t>(&o, NodePL::comps.size());
+  for (const auto& c : NodePL::comps) put(&o, c.maxSpeed);
+
+  // transit lines, and node and edge ids
+  std::unordered_map<const TransitEdgeLine*, uint32_t> lineIds;
+  std::vector<const TransitEdgeLine*> lines;
+  std::unordered_map<const Node*, uint32_t> nodeIds;
+  std::unordered_map<const Edge*, uint32_t> edgeIds;
+  uint64_t numEdges = 0;
+
+  for (const auto* n : g.getNds()) {
+    uint32_t nid = nodeIds.size();
+    nodeIds[n] = nid;
+    for (const auto* e : n->getAdjListOut()) {
+      uint32_t eid = edgeIds.size();
+      edgeIds[e] = eid;
+      numEdges++;
+      for (const auto* l : e->pl().getLines()) {
+        if (lineIds.count(l)) continue;
+        uint32_t lid = lines.size();
+        lineIds[l] = lid;
+        lines.push_back(l);
+      }
+    }
+  }
+
+  put<uint64_t>(&o, lines.size());
+  for (const auto* l : lines) {
+    putStr(&o, l->fromStr);
+    putStr(&o, l->toStr);
+    putStr(&o, l->shortName);
+    put(&o, l->color);
+  }
+
+  // nodes
+  put<uint64_t>(&o, nodeIds.size());
+  for (const auto* n : g.getNds()) {
+    put<double>(&o, n->pl().getGeom()->getX());
+    put<double>(&o, n->pl().getGeom()->getY());
+    put(&o, n->pl().getCompId());
+
+    if (n->pl().isBlocker()) {
+      put(&o, SI_BLOCKER);
+    } else if (n->pl().isTurnCycle()) {
+      put(&o, SI_TURNCYCLE);
+    } else if (n->pl().getSI()) {
+      const StatInfo* si = n->pl().getSI();
+      put(&o, SI_STAT);
+      putStr(&o, si->getName());
+      putStr(&o, si->getTrack());
+      put<uint32_t>(&o, si->getAltNames().size());
+      for (const auto& name : si->getAltNames()) putStr(&o, name);
+#ifdef PFAEDLE_STATION_IDS
+      putStr(&o, si->getId());
+#endif
+    } else {
+      put(&o, SI_NONE);
+    }
+  }
+
+  // edges, in the order of their ids
+  put(&o, numEdges);
+  for (const auto* n : g.getNds()) {
+    for (const auto* e : n->getAdjListOut()) {
+      const auto& pl = e->pl();
+      put(&o, nodeIds[e->getFrom()]);
+      put(&o, nodeIds[e->getTo()]);
+      put<uint8_t>(&o, pl.oneWay());
+      put<uint8_t>(&o, pl.isRestricted());
+      put<uint8_t>(&o, pl.isRev());
+      put<uint8_t>(&o, pl.lvl());
+      put(&o, pl.getCost());
+
+      if (pl.getGeom()) {
+        put<uint32_t>(&o, pl.getGeom()->size());
+        for (const auto& p : *pl.getGeom()) {
+          put<double>(&o, p.getX());
+          put<double>(&o, p.getY());
+        }
+      } else {
+        put<uint32_t>(&o, 0);
+      }
+
+      put<uint32_t>(&o, pl.getLines().size());
+      for (const auto* l : pl.getLines()) put(&o, lineIds[l]);
+    }
+  }
+
+  // restrictions, as (from, to) edge id pairs per via node. Rules with a
+  // from edge which is no longer in the graph never match and are dropped,
+  // as are negative rules with a removed to edge. A positive rule whose to
+  // edge was removed forbids every other turn from its from edge: it is
+  // written as negative rules for all edges at the via node, and the
+  // positive rules of the from edge behind it are unreachable
+  typedef std::vector<std::pair<uint32_t, uint32_t>> IdPairs;
+  std::map<uint32_t, IdPairs> pos, neg;
+
+  for (const auto& r : res.getPosRules()) {
+    auto via = nodeIds.find(r.first);
+    if (via == nodeIds.end()) continue;
+    std::unordered_set<const Edge*> blocked;
+    for (const auto& rp : r.second) {
+      auto from = edgeIds.find(rp.first);
+      if (from == edgeIds.end() || blocked.count(rp.first)) continue;
+      if (!rp.second) {
+        pos[via->second].push_back({from->second, NO_EDGE});
+        continue;
+      }
+      auto to = edgeIds.find(rp.second);
+      if (to != edgeIds.end()) {
+        pos[via->second].push_back({from->second, to->second});
+        continue;
+      }
+      blocked.insert(rp.first);
+      for (const auto* adj :
+           {&r.first->getAdjListOut(), &r.first->getAdjListIn()}) {
+        for (const auto* e : *adj) {
+          neg[via->second].push_back({from->second, edgeIds[e]});
+        }
+      }
+    }
+  }
+
+  for (const auto& r : res.getNegRules()) {
+    auto via = nodeIds.find(r.first);
+    if (via == nodeIds.end()) continue;
+    for (const auto& rp : r.second) {
+      auto from = edgeIds.find(rp.first);
+      if (from == edgeIds.end()) continue;
+      if (!rp.second) {
+        neg[via->second].push_back({from->second, NO_EDGE});
+        continue;
+      }
+      auto to = edgeIds.find(rp.second);
+      if (to != edgeIds.end()) {
+        neg[via->second].push_back({from->second, to->second});
+      }
+    }
+  }
+
+  for (const auto* rules : {&pos, &neg}) {
+    put<uint64_t>(&o, rules->size());
+    for (const auto& r : *rules) {
+      put(&o, r.first);
+      put<uint32_t>(&o, r.second.size());
+      for (const auto& rp : r.second) {
+        put(&o, rp.first);
+        put(&o, rp.second);
+      }
+    }
+  }
+
+  o.close();
+
+  if (!o.good() || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    LOG(WARN) << "Could not write graph snapshot to " << path;
+    unlink(tmpPath.c_str());
+    return;
+  }
+
+  LOG(DEBUG) << "Wrote graph snapshot to " << path;
+}
+
+// _____________________________________________________________________________
+bool GraphSnapshot::read(const std::string& path, uint64_t key, Graph* g,
+                         Restrictor* res,
+                         std::vector<TransitEdgeLine*>* lines) {
+  int f = open(path.c_str(), O_RDONLY);
+  if (f < 0) return false;
+
+  struct stat st;
+  if (fstat(f, &st) != 0 || st.st_size == 0) {
+    ::close(f);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void* m = mmap(0, size, PROT_READ, MAP_PRIVATE, f, 0);
+  ::close(f);
+  if (m == MAP_FAILED) return false;
+
+  // the snapshot is read front to back exactly once
+  madvise(m, size, MADV_SEQUENTIAL);
+
+  const char* c = static_cast<const char*>(m);
+  const char* end = c + size;
+
+  std::vector<TransitEdgeLine*> newLines;
+  std::vector<bool> usedLines;
+  bool ok = false;
+
+  try {
+    if (size < sizeof(MAGIC) || memcmp(c, MAGIC, sizeof(MAGIC)) != 0)
+      throw std::runtime_error("invalid magic number");
+    c += sizeof(MAGIC);
+
+    if (get<uint32_t>(&c, end) != VERSION)
+      throw std::runtime_error("version mismatch");
+    if (get<uint64_t>(&c, end) != key)
+      throw std::runtime_error("key mismatch");
+
+    std::vector<trgraph::Component> comps(getCount(&c, end));
+    for (auto& comp : comps) comp.maxSpeed = get<float>(&c, end);
+
+    uint64_t numLines = getCount(&c, end);
+    for (uint64_t i = 0; i < numLines; i++) {
+      TransitEdgeLine l;
+      l.fromStr = getStr(&c, end);
+      l.toStr = getStr(&c, end);
+      l.shortName = getStr(&c, end);
+      l.color = get<uint32_t>(&c, end);
+      newLines.push_back(new TransitEdgeLine(l));
+      usedLines.push_back(false);
+    }
+
+    std::vector<Node*> nodes(getCount(&c, end));
+    for (auto& n : nodes) {
+      PFDL_PREC x = get<double>(&c, end);
+      PFDL_PREC y = get<double>(&c, end);
+      n = g->addNd(NodePL(POINT{x, y}));
+      n->pl().setComp(get<uint32_t>(&c, end));
+
+      uint8_t si = get<uint8_t>(&c, end);
+      if (si == SI_BLOCKER) {
+        n->pl().setBlocker();
+      } else if (si == SI_TURNCYCLE) {
+        n->pl().setTurnCycle();
+      } else if (si == SI_STAT) {
+        std::string name = getStr(&c, end);
+        std::string track = getStr(&c, end);
+        StatInfo statInfo(name, track);
+        uint32_t numAlt = get<uint32_t>(&c, end);
+        for (uint32_t i = 0; i < numAlt; i++)
+          statInfo.addAltName(getStr(&c, end));
+#ifdef PFAEDLE_STATION_IDS
+        statInfo.setId(getStr(&c, end));
+#endif
+        n->pl().setSI(statInfo);
+      }
+    }
+
+    std::vector<Edge*> edges(getCount(&c, end));
+    for (auto& e : edges) {
+      uint32_t from = get<uint32_t>(&c, end);
+      uint32_t to = get<uint32_t>(&c, end);
+      if (from >= nodes.size() || to >= nodes.size())
+        throw std::runtime_error("invalid node id");
+
+      e = g->addEdg(nodes[from], nodes[to]);
+      auto& pl = e->pl();
+      pl.setOneWay(get<uint8_t>(&c, end));
+      if (get<uint8_t>(&c, end)) pl.setRestricted();
+      if (get<uint8_t>(&c, end)) pl.setRev();
+      pl.setLvl(get<uint8_t>(&c, end));
+      pl.setCost(get<uint32_t>(&c, end));
+
+      uint32_t numPoints = get<uint32_t>(&c, end);
+      for (uint32_t i = 0; i < numPoints; i++) {
+        PFDL_PREC x = get<double>(&c, end);
+        PFDL_PREC y = get<double>(&c, end);
+        pl.addPoint(POINT{x, y});
+      }
+
+      uint32_t numLines = get<uint32_t>(&c, end);
+      for (uint32_t i = 0; i < numLines; i++) {
+        uint32_t l = get<uint32_t>(&c, end);
+        if (l >= newLines.size()) throw std::runtime_error("invalid line id");
+        pl.addLine(newLines[l]);
+        usedLines[l] = true;
+      }
+    }
+
+    for (bool pos : {true, false}) {
+      uint64_t numRules = get<uint64_t>(&c, end);
+      for (uint64_t i = 0; i < numRules; i++) {
+        uint32_t via = get<uint32_t>(&c, end);
+        if (via >= nodes.size()) throw std::runtime_error("invalid node id");
+        uint32_t numPairs = get<uint32_t>(&c, end);
+        for (uint32_t j = 0; j < numPairs; j++) {
+          uint32_t from = get<uint32_t>(&c, end);
+          uint32_t to = get<uint32_t>(&c, end);
+          if ((from != NO_EDGE && from >= edges.size()) ||
+              (to != NO_EDGE && to >= edges.size()))
+            throw std::runtime_error("invalid edge id");
+          res->addRule(from == NO_EDGE ? 0 : edges[from],
+                       to == NO_EDGE ? 0 : edges[to], nodes[via], pos);
+        }
+      }
+    }
+
+    NodePL::comps = comps;
+    ok = true;
+  } catch (const std::runtime_error& e) {
+    LOG(WARN) << "Could not read graph snapshot " << path << ": " << e.what();
+  }
+
+  munmap(m, size);
+
+  if (!ok) {
+    // drop the partially read graph, lines added to edges are deleted
+    // together with their last edge
+    for (auto i = g->getNds().begin(); i != g->getNds().end();) {
+      i = g->delNd(*i);
+    }
+    *res = Restrictor();
+    for (size_t i = 0; i < newLines.size(); i++) {
+      if (!usedLines[i]) delete newLines[i];
+    }
+    return false;
+  }
+
+  lines->insert(lines->end(), newLines.begin(), newLines.end());
+  return true;
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, const void* buf, size_t n) {
+  // FNV-1a
+  const unsigned char* c = static_cast<const unsigned char*>(buf);
+  for (size_t i = 0; i < n; i++) {
+    *h ^= c[i];
+    *h *= 1099511628211ull;
+  }
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, const std::string& s) {
+  uint64_t size = s.size();
+  hash(h, &size, sizeof(size));
+  hash(h, s.data(), s.size());
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, double d) { hash(h, &d, sizeof(d)); }
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, const MultAttrMap& m) {
+  // unordered, hash in sorted key order
+  std::map<std::string, std::map<std::string, uint64_t>> sorted(m.begin(),
+                                                                m.end());
+  hash(h, static_cast<double>(sorted.size()));
+  for (const auto& kv : sorted) {
+    hash(h, kv.first);
+    hash(h, static_cast<double>(kv.second.size()));
+    for (const auto& vf : kv.second) {
+      hash(h, vf.first);
+      hash(h, &vf.second, sizeof(vf.second));
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, const DeepAttrLst& l) {
+  hash(h, static_cast<double>(l.size()));
+  for (const auto& r : l) {
+    hash(h, r.attr);
+    hash(h, r.relRule.kv.first);
+    hash(h, r.relRule.kv.second);
+    hash(h, static_cast<double>(r.relRule.flags.size()));
+    for (const auto& f : r.relRule.flags) hash(h, f);
+  }
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, const AttrLst& l) {
+  hash(h, static_cast<double>(l.size()));
+  for (const auto& a : l) hash(h, a);
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hash(uint64_t* h, const trgraph::Normalizer& n) {
+  hash(h, static_cast<double>(n.getRules().size()));
+  for (const auto& r : n.getRules()) {
+    hash(h, r.first);
+    hash(h, r.second);
+  }
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::hashFile(uint64_t* h, const std::string& path) {
+  // the full content is hashed, 8 bytes at a time
+  std::ifstream f(path, std::ios::binary);
+  std::vector<uint64_t> buf(1024 * 1024);
+  uint64_t fh = 0;
+  uint64_t size = 0;
+
+  while (f) {
+    f.read(reinterpret_cast<char*>(buf.data()), buf.size() * 8);
+    size_t n = f.gcount();
+    if (!n) break;
+    if (n % 8) memset(reinterpret_cast<char*>(buf.data()) + n, 0, 8 - n % 8);
+    size += n;
+    for (size_t i = 0; i < (n + 7) / 8; i++) {
+      fh = (fh ^ buf[i]) * 0x9E3779B97F4A7C15ull;
+      fh ^= fh >> 29;
+    }
+  }
+
+  hash(h, &size, sizeof(size));
+  hash(h, &fh, sizeof(fh));
+}
+
+// _____________________________________________________________________________
+template <typename T>
+void GraphSnapshot::put(std::ostream* o, const T& v) {
+  o->write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// _____________________________________________________________________________
+void GraphSnapshot::putStr(std::ostream* o, const std::string& s) {
+  put<uint32_t>(o, s.size());
+  o->write(s.data(), s.size());
+}
+
+// _____________________________________________________________________________
+template <typename T>
+T GraphSnapshot::get(const char** c, const char* end) {
+  if (end - *c < static_cast<ptrdiff_t>(sizeof(T)))
+    throw std::runtime_error("unexpected end of file");
+  T ret;
+  memcpy(&ret, *c, sizeof(T));
+  *c += sizeof(T);
+  return ret;
+}
+
+// _____________________________________________________________________________
+uint64_t GraphSnapshot::getCount(const char** c, const char* end) {
+  // every entry takes at least one byte, larger counts are corrupt
+  uint64_t ret = get<uint64_t>(c, end);
+  if (ret > static_cast<uint64_t>(end - *c))
+    throw std::runtime_error("invalid entry count");
+  return ret;
+}
+
+// _____________________________________________________________________________
+std::string GraphSnapshot::getStr(const char** c, const char* end) {
+  uint32_t size = get<uint32_t>(c, end);
+  if (end - *c < static_cast<ptrdiff_t>(size))
+    throw std::runtime_error("unexpected end of file");
+  std::string ret(*c, size);
+  *c += size;
+  return ret;
+}
@@ -0,0 +1,69 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_OSM_GRAPHSNAPSHOT_H_
+#define PFAEDLE_OSM_GRAPHSNAPSHOT_H_
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "pfaedle/osm/BBoxIdx.h"
+#include "pfaedle/osm/OsmReadOpts.h"
+#include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace osm {
+
+/*
+ * Versioned binary snapshot of a finished transit graph, together with its
+ * restrictions, the component table and the transit lines of its edges.
+ * Snapshots are keyed by the content of the OSM file, the read options, the
+ * bounding box and the grid size used to build the graph.
+ */
+class GraphSnapshot {
+ public:
+  // Return the key for a graph built from the OSM file at osmPath
+  static uint64_t getKey(const std::string& osmPath, const OsmReadOpts& opts,
+                         const BBoxIdx& box, double gridSize);
+
+  // Return the path of the snapshot with the given key in directory dir
+  static std::string getPath(const std::string& dir, uint64_t key);
+
+  // Write g and res to a snapshot at path
+  static void write(const std::string& path, uint64_t key,
+                    const trgraph::Graph& g, const Restrictor& res);
+
+  // Read the snapshot at path into the (empty) g and res. The transit lines
+  // created for the graph edges are added to lines. Return false if there is
+  // no valid snapshot with the given key at path
+  static bool read(const std::string& path, uint64_t key, trgraph::Graph* g,
+                   Restrictor* res,
+                   std::vector<trgraph::TransitEdgeLine*>* lines);
+
+  static const uint32_t VERSION = 2;
+
+ private:
+  static void hash(uint64_t* h, const void* buf, size_t n);
+  static void hash(uint64_t* h, const std::string& s);
+  static void hash(uint64_t* h, double d);
+  static void hash(uint64_t* h, const MultAttrMap& m);
+  static void hash(uint64_t* h, const DeepAttrLst& l);
+  static void hash(uint64_t* h, const AttrLst& l);
+  static void hash(uint64_t* h, const trgraph::Normalizer& n);
+  static void hashFile(uint64_t* h, const std::string& path);
+
+  template <typename T>
+  static void put(std::ostream* o, const T& v);
+  static void putStr(std::ostream* o, const std::string& s);
+
+  template <typename T>
+  static T get(const char** c, const char* end);
+  static std::string getStr(const char** c, const char* end);
+  static uint64_t getCount(const char** c, const char* end);
+};
+}  // namespace osm
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_OSM_GRAPHSNAPSHOT_H_
@@ -57,6 +57,25 @@ struct OsmNode {
   uint64_t dropFlags;
 };
 
+// Compact in-memory representation of a node, coordinates are stored in
+// the 1e-7 degree fixed-point resolution used by OSM itself
+struct OsmBufNode {
+  osmid id;
+  int32_t lat;
+  int32_t lng;
+};
+
+// Entities buffered during a single pass over an OSM file. Way and node
+// filtering which depends on relation memberships is deferred until the
+// relations have been read.
+struct OsmBuffer {
+  std::vector<OsmBufNode> nodes;
+  // kept attributes of buffered nodes, as (index into nodes, attributes)
+  // pairs in ascending index order
+  std::vector<std::pair<size_t, AttrMap>> nodeAttrs;
+  std::vector<OsmWay> ways;
+};
+
 struct Restriction {
   osmid eFrom, eTo;
 };
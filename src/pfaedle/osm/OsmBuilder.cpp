@@ -5,11 +5,12 @@
 #include <float.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <exception>
 #include <iostream>
 #include <limits>
 #include <map>
-#include <stack>
 #include <string>
 #include <utility>
 #include <vector>
@@ -17,6 +18,7 @@
 #include "pfaedle/Def.h"
 #include "pfaedle/_config.h"
 #include "pfaedle/osm/BBoxIdx.h"
+#include "pfaedle/osm/GraphSnapshot.h"
 #include "pfaedle/osm/Osm.h"
 #include "pfaedle/osm/OsmBuilder.h"
 #include "pfaedle/osm/OsmFilter.h"
@@ -31,9 +33,11 @@ using ad::cppgtfs::gtfs::Stop;
 using pfaedle::osm::BlockSearch;
 using pfaedle::osm::EdgeGrid;
 using pfaedle::osm::EqSearch;
+using pfaedle::osm::GraphSnapshot;
 using pfaedle::osm::NodeGrid;
 using pfaedle::osm::OsmBuilder;
 using pfaedle::osm::OsmNode;
+using pfaedle::osm::OsmPrefilter;
 using pfaedle::osm::OsmRel;
 using pfaedle::osm::OsmWay;
 using pfaedle::osm::source::OsmSource;
@@ -67,21 +71,102 @@ bool EqSearch::operator()(const Node* cand, const StatInfo* si) const {
   return cand->pl().getSI() && cand->pl().getSI()->simi(si) > minSimi;
 }
 
+// _____________________________________________________________________________
+OsmPrefilter::OsmPrefilter(const OsmFilter& filter,
+                           const AttrKeySet attrKeys[3])
+    : _filter(filter),
+      _keys(attrKeys),
+      _types{false, false, false},
+      _nodes(0),
+      _multNodes(0),
+      _nodeRels(0),
+      _wayRels(0) {}
+
+// _____________________________________________________________________________
+void OsmPrefilter::filterNodes(const NIdMap* nodes,
+                               const NIdMultMap* multNodes,
+                               const RelMap* nodeRels) {
+  _types[0] = true;
+  _nodes = nodes;
+  _multNodes = multNodes;
+  _nodeRels = nodeRels;
+}
+
+// _____________________________________________________________________________
+void OsmPrefilter::filterWays(const RelMap* wayRels) {
+  _types[1] = true;
+  _wayRels = wayRels;
+}
+
+// _____________________________________________________________________________
+void OsmPrefilter::filterRels() { _types[2] = true; }
+
+// _____________________________________________________________________________
+bool OsmPrefilter::wantsKey(uint8_t type, const char* key) const {
+  return type < 3 && _types[type] && _keys[type].count(key);
+}
+
+// _____________________________________________________________________________
+bool OsmPrefilter::keepNode(uint64_t id, const AttrMap& attrs) const {
+  if (!_types[0]) return true;
+  if (_nodes->count(id) || _multNodes->count(id)) return true;
+  return (_nodeRels->count(id) || _filter.keep(attrs, OsmFilter::NODE)) &&
+         !_filter.drop(attrs, OsmFilter::NODE);
+}
+
+// _____________________________________________________________________________
+bool OsmPrefilter::keepWay(uint64_t id, size_t numNodes,
+                           const AttrMap& attrs) const {
+  if (!_types[1]) return true;
+  if (numNodes < 2 || _filter.drop(attrs, OsmFilter::WAY)) return false;
+  if (!_wayRels) return true;
+  return _wayRels->count(id) || _filter.keep(attrs, OsmFilter::WAY);
+}
+
+// _____________________________________________________________________________
+bool OsmPrefilter::keepRel(uint64_t id, const AttrMap& attrs) const {
+  UNUSED(id);
+  if (!_types[2]) return true;
+  return attrs.size() && _filter.keep(attrs, OsmFilter::REL) &&
+         !_filter.drop(attrs, OsmFilter::REL);
+}
+
 // _____________________________________________________________________________
 OsmBuilder::OsmBuilder() {}
 
+// _____________________________________________________________________________
+OsmBuilder::OsmBuilder(const OsmIngestOpts& iOpts) : _iOpts(iOpts) {}
+
 // _____________________________________________________________________________
 void OsmBuilder::read(const std::string& path, const OsmReadOpts& opts,
                       Graph* g, const BBoxIdx& bbox, double gridSize,
                       Restrictor* res) {
   if (!bbox.size()) return;
 
+  uint64_t snapKey = 0;
+  std::string snapPath;
+
+  if (_iOpts.graphCacheDir.size()) {
+    snapKey = GraphSnapshot::getKey(path, opts, bbox, gridSize);
+    snapPath = GraphSnapshot::getPath(_iOpts.graphCacheDir, snapKey);
+
+    std::vector<TransitEdgeLine*> lines;
+    if (GraphSnapshot::read(snapPath, snapKey, g, res, &lines)) {
+      for (auto* l : lines) _lines[*l] = l;
+      LOG(INFO) << "Read graph snapshot " << snapPath;
+      LOG(DEBUG) << "Graph has " << g->getNds().size() << " nodes";
+      return;
+    }
+  }
+
   LOG(INFO) << "Reading OSM file " << path << " ... ";
 
   NodeSet orphanStations;
   EdgTracks eTracks;
   {
-    OsmIdSet bboxNodes, noHupNodes;
+    OsmIdSetStorage idStorage = _iOpts.memIdSet ? ID_SET_MEM : ID_SET_DISK;
+    OsmIdSet bboxNodes(idStorage, _iOpts.sortMem, _iOpts.pool);
+    OsmIdSet noHupNodes(idStorage, _iOpts.sortMem, _iOpts.pool);
 
     NIdMap nodes;
     NIdMultMap multNodes;
@@ -96,41 +181,97 @@ void OsmBuilder::read(const std::string& path, const OsmReadOpts& opts,
     OsmFilter filter(opts);
     OsmSource* source;
 
+    // prefilters for the individual passes, which may be evaluated on
+    // decoder threads of the source until it is deleted
+    OsmPrefilter singlePassFilter(filter, attrKeys);
+    OsmPrefilter relFilter(filter, attrKeys);
+    OsmPrefilter wayFilter(filter, attrKeys);
+    OsmPrefilter nodeFilter(filter, attrKeys);
+
     if (util::endsWith(path, ".pbf")) {
-      source = new PBFSource(path);
+      // the decoder threads block on I/O, so they are not run on the pool,
+      // but there are never more of them than pool threads
+      if (_iOpts.pool) {
+        source = new PBFSource(path, _iOpts.pool->getNumThreads());
+      } else {
+        source = new PBFSource(path);
+      }
     } else {
       source = new XMLSource(path);
     }
 
-    // we do four passes of the file here to be as memory creedy as possible:
-    // - the first pass collects all node IDs which are
-    //    * inside the given bounding box
-    //    * (TODO: maybe more filtering?)
-    //   these nodes are stored on the HD via OsmIdSet (which implements a
-    //   simple bloom filter / base 256 encoded id store
-    // - the second pass collects filtered relations
-    // - the third pass collects filtered ways which contain one of the nodes
-    //   from pass 1
-    // - the forth pass collects filtered nodes which were
-    //    * collected as node ids in pass 1
-    //    * match the filter criteria
-    //    * have been used in a way in pass 3
-
-    LOG(DEBUG) << "Reading bounding box nodes...";
-    readBBoxNds(source, &bboxNodes, &noHupNodes, filter, bbox);
-
-    LOG(DEBUG) << "Reading relations...";
-    readRels(source, &intmRels, &nodeRels, &wayRels, filter, attrKeys[2],
-             &rawRests);
-
-    LOG(DEBUG) << "Reading edges...";
-    readEdges(source, g, intmRels, wayRels, filter, bboxNodes, &nodes,
-              &multNodes, noHupNodes, attrKeys[1], rawRests, res, intmRels.flat,
-              &eTracks, opts);
-
-    LOG(DEBUG) << "Reading kept nodes...";
-    readNodes(source, g, intmRels, nodeRels, filter, bboxNodes, &nodes,
-              &multNodes, &orphanStations, attrKeys[0], intmRels.flat, opts);
+    if (_iOpts.singlePass) {
+      // a single pass over the file, which
+      // - collects the IDs of all nodes inside the bounding box (again
+      //   stored via OsmIdSet) and keeps their coordinates and kept
+      //   attributes in a compact in-memory buffer
+      // - buffers all ways which are not dropped by the filter and which
+      //   contain at least one bounding box node
+      // - collects the filtered relations
+      // as relation memberships are only known at the end of the file, the
+      // final keepWay() / keepNode() decisions are deferred to a replay of
+      // the buffered ways and nodes, in file order
+      OsmBuffer buf;
+
+      // nodes are all needed for the bounding box id set, relation
+      // memberships of ways are not yet known while reading them
+      singlePassFilter.filterWays(0);
+      singlePassFilter.filterRels();
+      source->setPrefilter(&singlePassFilter);
+
+      LOG(DEBUG) << "Reading OSM data in a single pass...";
+      readSinglePass(source, &bboxNodes, &noHupNodes, filter, bbox, attrKeys,
+                     &buf, &intmRels, &nodeRels, &wayRels, &rawRests);
+
+      LOG(DEBUG) << "Buffered " << buf.nodes.size() << " nodes and "
+                 << buf.ways.size() << " ways";
+
+      LOG(DEBUG) << "Reading edges...";
+      readEdges(&buf, source, g, intmRels, wayRels, filter, bboxNodes, &nodes,
+                &multNodes, noHupNodes, rawRests, res, intmRels.flat, &eTracks,
+                opts);
+
+      LOG(DEBUG) << "Reading kept nodes...";
+      readNodes(&buf, source, g, intmRels, nodeRels, filter, bboxNodes, &nodes,
+                &multNodes, &orphanStations, intmRels.flat, opts);
+    } else {
+      // we do four passes of the file here to be as memory creedy as
+      // possible:
+      // - the first pass collects all node IDs which are
+      //    * inside the given bounding box
+      //    * (TODO: maybe more filtering?)
+      //   these nodes are stored on the HD via OsmIdSet (which implements a
+      //   simple bloom filter / base 256 encoded id store
+      // - the second pass collects filtered relations
+      // - the third pass collects filtered ways which contain one of the
+      //   nodes from pass 1
+      // - the forth pass collects filtered nodes which were
+      //    * collected as node ids in pass 1
+      //    * match the filter criteria
+      //    * have been used in a way in pass 3
+
+      LOG(DEBUG) << "Reading bounding box nodes...";
+      readBBoxNds(source, &bboxNodes, &noHupNodes, filter, bbox);
+
+      LOG(DEBUG) << "Reading relations...";
+      relFilter.filterRels();
+      source->setPrefilter(&relFilter);
+      readRels(source, &intmRels, &nodeRels, &wayRels, filter, attrKeys[2],
+               &rawRests);
+
+      LOG(DEBUG) << "Reading edges...";
+      wayFilter.filterWays(&wayRels);
+      source->setPrefilter(&wayFilter);
+      readEdges(source, g, intmRels, wayRels, filter, bboxNodes, &nodes,
+                &multNodes, noHupNodes, attrKeys[1], rawRests, res,
+                intmRels.flat, &eTracks, opts);
+
+      LOG(DEBUG) << "Reading kept nodes...";
+      nodeFilter.filterNodes(&nodes, &multNodes, &nodeRels);
+      source->setPrefilter(&nodeFilter);
+      readNodes(source, g, intmRels, nodeRels, filter, bboxNodes, &nodes,
+                &multNodes, &orphanStations, attrKeys[0], intmRels.flat, opts);
+    }
 
     delete source;
   }
@@ -138,50 +279,72 @@ void OsmBuilder::read(const std::string& path, const OsmReadOpts& opts,
   LOG(DEBUG) << "OSM ID set lookups: " << osm::OsmIdSet::LOOKUPS
              << ", file lookups: " << osm::OsmIdSet::FLOOKUPS;
 
+  // without a given pool, use a temporary one with a thread per core for
+  // the graph cleanup stages
+  std::unique_ptr<ThreadPool> tmpPool;
+  ThreadPool* pool = ThreadPool::getOrTmp(_iOpts.pool, &tmpPool);
+
   LOG(DEBUG) << "Applying edge track numbers...";
   writeEdgeTracks(eTracks);
   eTracks.clear();
 
   {
     LOG(DEBUG) << "Fixing gaps...";
+    T_START(fixGaps);
     NodeGrid ng = buildNodeIdx(g, gridSize, bbox.getFullBox(), false);
     LOG(DEBUG) << "Grid size of " << ng.getXWidth() << "x" << ng.getYHeight();
     fixGaps(g, &ng);
+    LOG(DEBUG) << "Fixed gaps in " << T_STOP(fixGaps) << " ms";
   }
 
   LOG(DEBUG) << "Snapping stations...";
+  T_START(snapStats);
   snapStats(opts, g, bbox, gridSize, res, orphanStations);
+  LOG(DEBUG) << "Snapped stations in " << T_STOP(snapStats) << " ms";
 
   LOG(DEBUG) << "Collapsing edges...";
+  T_START(collapse);
   collapseEdges(g);
+  LOG(DEBUG) << "Collapsed edges in " << T_STOP(collapse) << " ms";
 
   LOG(DEBUG) << "Writing edge geoms...";
-  writeGeoms(g, opts);
+  T_START(geoms);
+  writeGeoms(g, opts, pool);
+  LOG(DEBUG) << "Wrote edge geoms in " << T_STOP(geoms) << " ms";
 
   LOG(DEBUG) << "Deleting orphan nodes...";
+  T_START(orphNds);
   deleteOrphNds(g, opts);
+  LOG(DEBUG) << "Deleted orphan nodes in " << T_STOP(orphNds) << " ms";
 
   LOG(DEBUG) << "Writing graph components...";
   // the restrictor is needed here to prevent connections in the graph
   // which are not possible in reality
-  uint32_t comps = writeComps(g, opts);
+  T_START(comps);
+  uint32_t comps = writeComps(g, opts, pool);
+  LOG(DEBUG) << "Wrote graph components in " << T_STOP(comps) << " ms";
 
   LOG(DEBUG) << "Simplifying geometries...";
-  simplifyGeoms(g);
+  T_START(simplify);
+  simplifyGeoms(g, pool);
+  LOG(DEBUG) << "Simplified geometries in " << T_STOP(simplify) << " ms";
 
   LOG(DEBUG) << "Writing other-direction edges...";
+  T_START(oDirEdgs);
   writeODirEdgs(g, res);
+  LOG(DEBUG) << "Wrote other-direction edges in " << T_STOP(oDirEdgs)
+             << " ms";
 
-  LOG(DEBUG) << "Write wrong-direction costs...";
-  writeOneWayPens(g, opts);
-
-  if (opts.noLinesPunishFact != 1.0) {
-    LOG(DEBUG) << "Write no-line pens...";
-    writeNoLinePens(g, opts);
-  }
+  LOG(DEBUG) << "Write wrong-direction and no-line costs...";
+  T_START(pens);
+  writePens(g, opts, pool);
+  LOG(DEBUG) << "Wrote costs in " << T_STOP(pens) << " ms";
 
   LOG(DEBUG) << "Write dummy node self-edges...";
+  T_START(selfEdgs);
   writeSelfEdgs(g);
+  LOG(DEBUG) << "Wrote dummy node self-edges in " << T_STOP(selfEdgs)
+             << " ms";
 
   size_t numEdges = 0;
 
@@ -193,6 +356,8 @@ void OsmBuilder::read(const std::string& path, const OsmReadOpts& opts,
              << " edges and " << comps
              << " connected component(s) with more than 1 node";
   LOG(DEBUG) << _lines.size() << " transit lines have been read.";
+
+  if (snapPath.size()) GraphSnapshot::write(snapPath, snapKey, *g, *res);
 }
 
 // _____________________________________________________________________________
@@ -531,6 +696,86 @@ void OsmBuilder::readBBoxNds(OsmSource* source, OsmIdSet* nodes,
   }
 }
 
+// _____________________________________________________________________________
+void OsmBuilder::readSinglePass(OsmSource* source, OsmIdSet* bBoxNodes,
+                                OsmIdSet* noHupNodes, const OsmFilter& filter,
+                                const BBoxIdx& bbox,
+                                const AttrKeySet attrKeys[3], OsmBuffer* buf,
+                                RelLst* rels, RelMap* nodeRels,
+                                RelMap* wayRels, Restrictions* rests) const {
+  const OsmSourceNode* nd;
+
+  while ((nd = source->nextNode())) {
+    bool inBox = bbox.contains(Point<double>(nd->lon, nd->lat));
+    if (inBox) {
+      bBoxNodes->add(nd->id);
+      buf->nodes.push_back({nd->id,
+                            static_cast<int32_t>(std::lround(nd->lat * 1e7)),
+                            static_cast<int32_t>(std::lround(nd->lon * 1e7))});
+    } else {
+      bBoxNodes->nadd(nd->id);
+    }
+
+    source->cont();
+
+    OsmSourceAttr attr;
+    AttrMap attrs;
+
+    while ((attr = source->nextAttr()).key) {
+      if (filter.nohup(attr.key, attr.value)) {
+        noHupNodes->add(nd->id);
+      }
+      // only nodes inside the bounding box may ever be kept
+      if (inBox && attrKeys[0].count(attr.key)) attrs[attr.key] = attr.value;
+      source->cont();
+    }
+
+    if (attrs.size()) {
+      buf->nodeAttrs.push_back({buf->nodes.size() - 1, std::move(attrs)});
+    }
+  }
+
+  const OsmSourceWay* way;
+
+  while ((way = source->nextWay())) {
+    OsmWay w;
+    w.id = way->id;
+
+    source->cont();
+
+    uint64_t nid;
+
+    while ((nid = source->nextMemberNode())) {
+      w.nodes.push_back(nid);
+      source->cont();
+    }
+
+    OsmSourceAttr attr;
+
+    while ((attr = source->nextAttr()).key) {
+      if (attrKeys[1].count(attr.key)) w.attrs[attr.key] = attr.value;
+      source->cont();
+    }
+
+    // relation memberships are not yet known here, so only the parts of
+    // keepWay() which do not depend on them are checked
+    if (!w.id || w.nodes.size() < 2 || filter.drop(w.attrs, OsmFilter::WAY))
+      continue;
+
+    for (osmid nid : w.nodes) {
+      if (bBoxNodes->has(nid)) {
+        buf->ways.push_back(std::move(w));
+        break;
+      }
+    }
+  }
+
+  OsmRel rel;
+  while ((rel = nextRel(source, filter, attrKeys[2])).id) {
+    addRel(rel, rels, nodeRels, wayRels, filter, rests);
+  }
+}
+
 // _____________________________________________________________________________
 OsmWay OsmBuilder::nextWayWithId(OsmSource* source, osmid wid,
                                  const AttrKeySet& keepAttrs) const {
@@ -677,52 +922,83 @@ void OsmBuilder::readEdges(OsmSource* source, Graph* g, const RelLst& rels,
 
   OsmWay w;
   while ((w = nextWay(source, wayRels, filter, bBoxNodes, keepAttrs, fl)).id) {
-    Node* last = 0;
-    std::vector<TransitEdgeLine*> lines;
-    if (wayRels.count(w.id)) {
-      lines = getLines(wayRels.find(w.id)->second, rels, opts, source);
-    }
-    std::string track =
-        getAttrByFirstMatch(opts.edgePlatformRules, w.id, w.attrs, wayRels,
-                            rels, opts.trackNormzer, source);
+    addWay(w, source, g, rels, wayRels, filter, bBoxNodes, nodes, multiNodes,
+           noHupNodes, rawRests, restor, eTracks, opts);
+  }
+}
 
-    osmid lastnid = 0;
-    for (osmid nid : w.nodes) {
-      Node* n = 0;
-      if (noHupNodes.has(nid)) {
-        n = g->addNd();
-        (*multiNodes)[nid].insert(n);
-      } else if (!nodes->count(nid)) {
-        if (!bBoxNodes.has(nid)) continue;
-        n = g->addNd();
-        (*nodes)[nid] = n;
-      } else {
-        n = (*nodes)[nid];
-      }
+// _____________________________________________________________________________
+void OsmBuilder::readEdges(OsmBuffer* buf, const OsmSource* source, Graph* g,
+                           const RelLst& rels, const RelMap& wayRels,
+                           const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+                           NIdMap* nodes, NIdMultMap* multiNodes,
+                           const OsmIdSet& noHupNodes,
+                           const Restrictions& rawRests, Restrictor* restor,
+                           const FlatRels& fl, EdgTracks* eTracks,
+                           const OsmReadOpts& opts) {
+  for (const auto& w : buf->ways) {
+    if (!keepWay(w, wayRels, filter, bBoxNodes, fl)) continue;
+    addWay(w, source, g, rels, wayRels, filter, bBoxNodes, nodes, multiNodes,
+           noHupNodes, rawRests, restor, eTracks, opts);
+  }
 
-      if (last) {
-        auto e = g->addEdg(last, n, EdgePL());
-        if (!e) continue;
+  // the ways are not needed anymore
+  std::vector<OsmWay>().swap(buf->ways);
+}
 
-        processRestr(nid, w.id, rawRests, e, n, restor);
-        processRestr(lastnid, w.id, rawRests, e, last, restor);
+// _____________________________________________________________________________
+void OsmBuilder::addWay(const OsmWay& w, const OsmSource* source, Graph* g,
+                        const RelLst& rels, const RelMap& wayRels,
+                        const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+                        NIdMap* nodes, NIdMultMap* multiNodes,
+                        const OsmIdSet& noHupNodes,
+                        const Restrictions& rawRests, Restrictor* restor,
+                        EdgTracks* eTracks, const OsmReadOpts& opts) {
+  Node* last = 0;
+  std::vector<TransitEdgeLine*> lines;
+  if (wayRels.count(w.id)) {
+    lines = getLines(wayRels.find(w.id)->second, rels, opts, source);
+  }
+  std::string track =
+      getAttrByFirstMatch(opts.edgePlatformRules, w.id, w.attrs, wayRels,
+                          rels, opts.trackNormzer, source);
+
+  osmid lastnid = 0;
+  for (osmid nid : w.nodes) {
+    Node* n = 0;
+    if (noHupNodes.has(nid)) {
+      n = g->addNd();
+      (*multiNodes)[nid].insert(n);
+    } else if (!nodes->count(nid)) {
+      if (!bBoxNodes.has(nid)) continue;
+      n = g->addNd();
+      (*nodes)[nid] = n;
+    } else {
+      n = (*nodes)[nid];
+    }
 
-        e->pl().addLines(lines);
-        e->pl().setLvl(filter.level(w.attrs));
-        if (!track.empty()) (*eTracks)[e] = track;
+    if (last) {
+      auto e = g->addEdg(last, n, EdgePL());
+      if (!e) continue;
 
-        if (filter.oneway(w.attrs)) {
-          e->pl().setOneWay(1);
-          LOG(DEBUG) << "Way " << w.id << ": Set oneway=1 (forward)";
-        }
-        if (filter.onewayrev(w.attrs)) {
-          e->pl().setOneWay(2);
-          LOG(DEBUG) << "Way " << w.id << ": Set oneway=2 (reverse)";
-        }
+      processRestr(nid, w.id, rawRests, e, n, restor);
+      processRestr(lastnid, w.id, rawRests, e, last, restor);
+
+      e->pl().addLines(lines);
+      e->pl().setLvl(filter.level(w.attrs));
+      if (!track.empty()) (*eTracks)[e] = track;
+
+      if (filter.oneway(w.attrs)) {
+        e->pl().setOneWay(1);
+        LOG(DEBUG) << "Way " << w.id << ": Set oneway=1 (forward)";
+      }
+      if (filter.onewayrev(w.attrs)) {
+        e->pl().setOneWay(2);
+        LOG(DEBUG) << "Way " << w.id << ": Set oneway=2 (reverse)";
       }
-      lastnid = nid;
-      last = n;
     }
+    lastnid = nid;
+    last = n;
   }
 }
 
@@ -842,10 +1118,64 @@ void OsmBuilder::readNodes(OsmSource* source, Graph* g, const RelLst& rels,
   while ((nd = nextNode(source, nodes, multNodes, nodeRels, filter, bBoxNodes,
                         keepAttrs, fl))
              .id) {
-    Node* n = 0;
-    POINT pos = {nd.lng, nd.lat};
-    if (nodes->count(nd.id)) {
-      n = (*nodes)[nd.id];
+    addNode(nd, source, g, rels, nodeRels, filter, nodes, multNodes,
+            orphanStations, opts);
+  }
+}
+
+// _____________________________________________________________________________
+void OsmBuilder::readNodes(OsmBuffer* buf, const OsmSource* source, Graph* g,
+                           const RelLst& rels, const RelMap& nodeRels,
+                           const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+                           NIdMap* nodes, NIdMultMap* multNodes,
+                           NodeSet* orphanStations, const FlatRels& fl,
+                           const OsmReadOpts& opts) const {
+  size_t attrI = 0;
+  OsmNode nd;
+
+  for (size_t i = 0; i < buf->nodes.size(); i++) {
+    nd.id = buf->nodes[i].id;
+    nd.lat = buf->nodes[i].lat / 1e7;
+    nd.lng = buf->nodes[i].lng / 1e7;
+    nd.attrs.clear();
+
+    if (attrI < buf->nodeAttrs.size() && buf->nodeAttrs[attrI].first == i) {
+      nd.attrs.swap(buf->nodeAttrs[attrI].second);
+      attrI++;
+    }
+
+    if (!keepNode(nd, *nodes, *multNodes, nodeRels, bBoxNodes, filter, fl))
+      continue;
+
+    addNode(nd, source, g, rels, nodeRels, filter, nodes, multNodes,
+            orphanStations, opts);
+  }
+
+  std::vector<OsmBufNode>().swap(buf->nodes);
+  std::vector<std::pair<size_t, AttrMap>>().swap(buf->nodeAttrs);
+}
+
+// _____________________________________________________________________________
+void OsmBuilder::addNode(const OsmNode& nd, const OsmSource* source, Graph* g,
+                         const RelLst& rels, const RelMap& nodeRels,
+                         const OsmFilter& filter, NIdMap* nodes,
+                         NIdMultMap* multNodes, NodeSet* orphanStations,
+                         const OsmReadOpts& opts) const {
+  Node* n = 0;
+  POINT pos = {nd.lng, nd.lat};
+  if (nodes->count(nd.id)) {
+    n = nodes->find(nd.id)->second;
+    n->pl().setGeom(pos);
+    if (filter.station(nd.attrs)) {
+      auto si = getStatInfo(nd.id, nd.attrs, nodeRels, rels, opts, source);
+      if (!si.isNull()) n->pl().setSI(si);
+    } else if (filter.blocker(nd.attrs)) {
+      n->pl().setBlocker();
+    } else if (filter.turnCycle(nd.attrs)) {
+      n->pl().setTurnCycle();
+    }
+  } else if ((*multNodes).count(nd.id)) {
+    for (auto* n : multNodes->find(nd.id)->second) {
       n->pl().setGeom(pos);
       if (filter.station(nd.attrs)) {
         auto si = getStatInfo(nd.id, nd.attrs, nodeRels, rels, opts, source);
@@ -855,27 +1185,15 @@ void OsmBuilder::readNodes(OsmSource* source, Graph* g, const RelLst& rels,
       } else if (filter.turnCycle(nd.attrs)) {
         n->pl().setTurnCycle();
       }
-    } else if ((*multNodes).count(nd.id)) {
-      for (auto* n : (*multNodes)[nd.id]) {
-        n->pl().setGeom(pos);
-        if (filter.station(nd.attrs)) {
-          auto si = getStatInfo(nd.id, nd.attrs, nodeRels, rels, opts, source);
-          if (!si.isNull()) n->pl().setSI(si);
-        } else if (filter.blocker(nd.attrs)) {
-          n->pl().setBlocker();
-        } else if (filter.turnCycle(nd.attrs)) {
-          n->pl().setTurnCycle();
-        }
-      }
-    } else {
-      // these are nodes without any connected edges
-      if (filter.station(nd.attrs)) {
-        auto tmp = g->addNd(NodePL(pos));
-        auto si = getStatInfo(nd.id, nd.attrs, nodeRels, rels, opts, source);
-        if (!si.isNull()) tmp->pl().setSI(si);
-        if (tmp->pl().getSI()) {
-          orphanStations->insert(tmp);
-        }
+    }
+  } else {
+    // these are nodes without any connected edges
+    if (filter.station(nd.attrs)) {
+      auto tmp = g->addNd(NodePL(pos));
+      auto si = getStatInfo(nd.id, nd.attrs, nodeRels, rels, opts, source);
+      if (!si.isNull()) tmp->pl().setSI(si);
+      if (tmp->pl().getSI()) {
+        orphanStations->insert(tmp);
       }
     }
   }
@@ -947,18 +1265,25 @@ void OsmBuilder::readRels(OsmSource* source, RelLst* rels, RelMap* nodeRels,
 
   OsmRel rel;
   while ((rel = nextRel(source, filter, keepAttrs)).id) {
-    rels->rels.push_back(rel.attrs);
-    if (rel.keepFlags & osm::REL_NO_DOWN) {
-      rels->flat.insert(rels->rels.size() - 1);
-    }
-    for (osmid id : rel.nodes) (*nodeRels)[id].push_back(rels->rels.size() - 1);
-    for (osmid id : rel.ways) (*wayRels)[id].push_back(rels->rels.size() - 1);
-
-    // TODO(patrick): this is not needed for the filtering - remove it here!
-    readRestr(rel, rests, filter);
+    addRel(rel, rels, nodeRels, wayRels, filter, rests);
   }
 }
 
+// _____________________________________________________________________________
+void OsmBuilder::addRel(const OsmRel& rel, RelLst* rels, RelMap* nodeRels,
+                        RelMap* wayRels, const OsmFilter& filter,
+                        Restrictions* rests) const {
+  rels->rels.push_back(rel.attrs);
+  if (rel.keepFlags & osm::REL_NO_DOWN) {
+    rels->flat.insert(rels->rels.size() - 1);
+  }
+  for (osmid id : rel.nodes) (*nodeRels)[id].push_back(rels->rels.size() - 1);
+  for (osmid id : rel.ways) (*wayRels)[id].push_back(rels->rels.size() - 1);
+
+  // TODO(patrick): this is not needed for the filtering - remove it here!
+  readRestr(rel, rests, filter);
+}
+
 // _____________________________________________________________________________
 void OsmBuilder::readRestr(const OsmRel& rel, Restrictions* rests,
                            const OsmFilter& filter) const {
@@ -1086,14 +1411,29 @@ double OsmBuilder::dist(const Node* a, const Node* b) {
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::writeGeoms(Graph* g, const OsmReadOpts& opts) {
-  for (auto* n : g->getNds()) {
+void OsmBuilder::writeGeoms(Graph* g, const OsmReadOpts& opts,
+                            ThreadPool* pool) {
+  // creating a geometry registers it in a map shared by all edges, so edges
+  // without one are collected and handled sequentially
+  std::vector<std::vector<Edge*>> noGeom(pool->getNumThreads());
+
+  forEachNd(g, pool, [&](size_t t, Node* n) {
     for (auto* e : n->getAdjListOut()) {
       if (!e->pl().getGeom()) {
-        e->pl().addPoint(*e->getFrom()->pl().getGeom());
-        e->pl().addPoint(*e->getTo()->pl().getGeom());
+        noGeom[t].push_back(e);
+        continue;
       }
 
+      e->pl().setCost(
+          costToInt(e->pl().getLength() / opts.levelDefSpeed[e->pl().lvl()]));
+    }
+  });
+
+  for (const auto& edgs : noGeom) {
+    for (auto* e : edgs) {
+      e->pl().addPoint(*e->getFrom()->pl().getGeom());
+      e->pl().addPoint(*e->getTo()->pl().getGeom());
+
       e->pl().setCost(
           costToInt(e->pl().getLength() / opts.levelDefSpeed[e->pl().lvl()]));
     }
@@ -1650,56 +1990,152 @@ void OsmBuilder::collapseEdges(Graph* g) {
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::simplifyGeoms(Graph* g) {
-  for (auto* n : g->getNds()) {
-    for (auto* e : n->getAdjListOut()) {
-      (*e->pl().getGeom()) =
-          util::geo::simplify(*e->pl().getGeom(), 0.5 / M_PER_DEG);
-    }
+void OsmBuilder::simplifyGeoms(Graph* g, ThreadPool* pool) {
+  size_t numThreads = pool->getNumThreads();
+  std::vector<std::vector<LINE*>> thrGeoms(numThreads);
+
+  forEachNd(g, pool, [&](size_t t, Node* n) {
+    for (auto* e : n->getAdjListOut()) thrGeoms[t].push_back(e->pl().getGeom());
+  });
+
+  // edges may share a geometry, simplify each one only once
+  std::vector<LINE*> geoms;
+  for (const auto& tg : thrGeoms) {
+    geoms.insert(geoms.end(), tg.begin(), tg.end());
   }
+  std::sort(geoms.begin(), geoms.end());
+  geoms.erase(std::unique(geoms.begin(), geoms.end()), geoms.end());
+
+  size_t n = geoms.size();
+  pool->run(numThreads, [&](size_t t) {
+    for (size_t i = t * n / numThreads; i < (t + 1) * n / numThreads; i++) {
+      *geoms[i] = util::geo::simplify(*geoms[i], 0.5 / M_PER_DEG);
+    }
+  });
 }
 
 // _____________________________________________________________________________
-uint32_t OsmBuilder::writeComps(Graph* g, const OsmReadOpts& opts) {
-  NodePL::comps.clear();
-  NodePL::comps.emplace_back(Component{0});
-  uint32_t numC = 0;
-  uint64_t numNds = 0;
+void OsmBuilder::forEachNd(Graph* g, ThreadPool* pool,
+                           const std::function<void(size_t, Node*)>& f) {
+  std::vector<Node*> nds(g->getNds().begin(), g->getNds().end());
+  size_t n = nds.size();
+  size_t numThreads = pool->getNumThreads();
+
+  pool->run(numThreads, [&](size_t t) {
+    for (size_t i = t * n / numThreads; i < (t + 1) * n / numThreads; i++) {
+      f(t, nds[i]);
+    }
+  });
+}
+
+// _____________________________________________________________________________
+uint32_t OsmBuilder::writeComps(Graph* g, const OsmReadOpts& opts,
+                                ThreadPool* pool) {
+  // without a given pool, use a temporary one with a thread per core
+  std::unique_ptr<ThreadPool> tmpPool;
+  pool = ThreadPool::getOrTmp(pool, &tmpPool);
+  size_t numThreads = pool->getNumThreads();
+
+  // number the nodes, the number is temporarily stored as the component id
+  std::vector<Node*> nds(g->getNds().begin(), g->getNds().end());
+  size_t n = nds.size();
+  for (size_t i = 0; i < n; i++) nds[i]->pl().setComp(i + 1);
 
   double fac = opts.maxSpeedCorFac;
 
-  for (auto* n : g->getNds()) {
-    if (!n->pl().getCompId()) {
-      std::stack<std::pair<Node*, Edge*>> q;
-      q.push(std::pair<Node*, Edge*>(n, 0));
-      while (!q.empty()) {
-        std::pair<Node*, Edge*> cur = q.top();
-        q.pop();
-
-        cur.first->pl().setComp(NodePL::comps.size());
-        numNds++;
-        for (auto* e : cur.first->getAdjListOut()) {
-          double speed = opts.levelDefSpeed[e->pl().lvl()] / fac;
-          if (speed > NodePL::comps.back().maxSpeed)
-            NodePL::comps.back().maxSpeed = speed;
-          if (!e->getOtherNd(cur.first)->pl().getCompId())
-            q.push(std::pair<Node*, Edge*>(e->getOtherNd(cur.first), e));
-        }
-        for (auto* e : cur.first->getAdjListIn()) {
-          double speed = opts.levelDefSpeed[e->pl().lvl()] / fac;
-          if (speed > NodePL::comps.back().maxSpeed)
-            NodePL::comps.back().maxSpeed = speed;
-          if (!e->getOtherNd(cur.first)->pl().getCompId())
-            q.push(std::pair<Node*, Edge*>(e->getOtherNd(cur.first), e));
-        }
+  // the compact edge list of each thread, and the max speed of the edges
+  // adjacent to each node
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> edgs(numThreads);
+  std::vector<double> speeds(n, 0);
+
+  pool->run(numThreads, [&](size_t t) {
+    for (size_t i = t * n / numThreads; i < (t + 1) * n / numThreads; i++) {
+      for (auto* e : nds[i]->getAdjListOut()) {
+        double speed = opts.levelDefSpeed[e->pl().lvl()] / fac;
+        speeds[i] = std::max(speeds[i], speed);
+        edgs[t].push_back({i, e->getTo()->pl().getCompId() - 1});
+      }
+      for (auto* e : nds[i]->getAdjListIn()) {
+        double speed = opts.levelDefSpeed[e->pl().lvl()] / fac;
+        speeds[i] = std::max(speeds[i], speed);
+      }
+    }
+  });
+
+  // union-find, the root of a set is always its smallest node, so each
+  // component ends up with the same id as in a sequential search in node
+  // order
+  std::vector<std::atomic<uint32_t>> parents(n);
+  pool->run(numThreads, [&](size_t t) {
+    for (size_t i = t * n / numThreads; i < (t + 1) * n / numThreads; i++) {
+      parents[i].store(i, std::memory_order_relaxed);
+    }
+  });
+
+  auto find = [&parents](uint32_t i) {
+    uint32_t p = parents[i].load(std::memory_order_relaxed);
+    while (p != i) {
+      // path halving, only ever points a node to one of its ancestors
+      uint32_t gp = parents[p].load(std::memory_order_relaxed);
+      if (gp != p) parents[i].store(gp, std::memory_order_relaxed);
+      i = gp;
+      p = parents[i].load(std::memory_order_relaxed);
+    }
+    return i;
+  };
+
+  pool->run(numThreads, [&](size_t t) {
+    for (const auto& e : edgs[t]) {
+      uint32_t a = find(e.first);
+      uint32_t b = find(e.second);
+      while (a != b) {
+        if (a < b) std::swap(a, b);
+        // link the larger root below the smaller one, retry if it was
+        // linked by another thread in between
+        uint32_t exp = a;
+        if (parents[a].compare_exchange_weak(exp, b)) break;
+        a = find(a);
+        b = find(b);
       }
+    }
+  });
+
+  std::vector<uint32_t> roots(n);
+  pool->run(numThreads, [&](size_t t) {
+    for (size_t i = t * n / numThreads; i < (t + 1) * n / numThreads; i++) {
+      roots[i] = find(i);
+    }
+  });
+
+  // number the components in node order and reduce their max speeds, the
+  // root of a node always comes before or at the node itself
+  std::vector<uint32_t> compIds(n, 0);
+  std::vector<uint8_t> nonTriv(n, 0);
+  uint32_t numC = 0;
 
-      if (numNds > 1) numC++;
+  NodePL::comps.clear();
+  NodePL::comps.emplace_back(Component{0});
+
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = roots[i];
+    if (r == i) {
+      compIds[i] = NodePL::comps.size();
       NodePL::comps.emplace_back(Component{0});
-      numNds = 0;
+    } else if (!nonTriv[r]) {
+      nonTriv[r] = 1;
+      numC++;
     }
+
+    auto& comp = NodePL::comps[compIds[r] - 1];
+    if (speeds[i] > comp.maxSpeed) comp.maxSpeed = speeds[i];
   }
 
+  pool->run(numThreads, [&](size_t t) {
+    for (size_t i = t * n / numThreads; i < (t + 1) * n / numThreads; i++) {
+      nds[i]->pl().setComp(compIds[roots[i]]);
+    }
+  });
+
   return numC;
 }
 
@@ -1748,30 +2184,24 @@ void OsmBuilder::writeSelfEdgs(Graph* g) {
 }
 
 // _____________________________________________________________________________
-void OsmBuilder::writeNoLinePens(Graph* g, const OsmReadOpts& opts) {
-  for (auto* n : g->getNds()) {
+void OsmBuilder::writePens(Graph* g, const OsmReadOpts& opts,
+                           ThreadPool* pool) {
+  forEachNd(g, pool, [&](size_t, Node* n) {
     for (auto* e : n->getAdjListOut()) {
-      if (e->pl().getLines().size() == 0) {
+      if (e->pl().oneWay() == 2) {
         double c = e->pl().getCost();
         c = c / 10.0;  // convert into seconds
-        e->pl().setCost(costToInt(c * opts.noLinesPunishFact));
+        e->pl().setCost(
+            costToInt(c * opts.oneWaySpeedPen + opts.oneWayEntryCost));
       }
-    }
-  }
-}
 
-// _____________________________________________________________________________
-void OsmBuilder::writeOneWayPens(Graph* g, const OsmReadOpts& opts) {
-  for (auto* n : g->getNds()) {
-    for (auto* e : n->getAdjListOut()) {
-      if (e->pl().oneWay() == 2) {
+      if (opts.noLinesPunishFact != 1.0 && e->pl().getLines().size() == 0) {
         double c = e->pl().getCost();
         c = c / 10.0;  // convert into seconds
-        e->pl().setCost(
-            costToInt(c * opts.oneWaySpeedPen + opts.oneWayEntryCost));
+        e->pl().setCost(costToInt(c * opts.noLinesPunishFact));
       }
     }
-  }
+  });
 }
 
 // _____________________________________________________________________________
@@ -4,6 +4,7 @@
 
 #ifndef PFAEDLE_OSM_OSMBUILDER_H_
 #define PFAEDLE_OSM_OSMBUILDER_H_
+#include <functional>
 #include <map>
 #include <queue>
 #include <set>
@@ -14,6 +15,7 @@
 
 #include "ad/cppgtfs/gtfs/Feed.h"
 #include "pfaedle/Def.h"
+#include "pfaedle/ThreadPool.h"
 #include "pfaedle/osm/BBoxIdx.h"
 #include "pfaedle/osm/OsmFilter.h"
 #include "pfaedle/osm/OsmIdSet.h"
@@ -76,12 +78,77 @@ inline bool operator<(const NodeCand& a, const NodeCand& b) {
 
 typedef std::priority_queue<NodeCand> NodeCandPQ;
 
+/*
+ * Prefilter handed to the OSM source while reading, which may evaluate it
+ * concurrently on decoder threads. It only checks necessary conditions of
+ * keepNode(), keepWay() and nextRel(), entities of types which have not been
+ * enabled are passed through.
+ */
+class OsmPrefilter : public source::OsmSourcePrefilter {
+ public:
+  OsmPrefilter(const OsmFilter& filter, const AttrKeySet attrKeys[3]);
+
+  // Skip nodes which are neither used by a way nor kept by the filter or by
+  // a relation. The maps must not be changed structurally while reading.
+  void filterNodes(const NIdMap* nodes, const NIdMultMap* multNodes,
+                   const RelMap* nodeRels);
+
+  // Skip ways with less than 2 nodes or dropped by the filter. If wayRels is
+  // given, also skip ways which are neither kept by the filter nor by a
+  // relation.
+  void filterWays(const RelMap* wayRels);
+
+  // Skip relations which are not kept by the filter
+  void filterRels();
+
+  virtual bool wantsKey(uint8_t type, const char* key) const;
+  virtual bool keepNode(uint64_t id, const AttrMap& attrs) const;
+  virtual bool keepWay(uint64_t id, size_t numNodes,
+                       const AttrMap& attrs) const;
+  virtual bool keepRel(uint64_t id, const AttrMap& attrs) const;
+
+ private:
+  const OsmFilter& _filter;
+  const AttrKeySet* _keys;
+  bool _types[3];
+
+  const NIdMap* _nodes;
+  const NIdMultMap* _multNodes;
+  const RelMap* _nodeRels;
+  const RelMap* _wayRels;
+};
+
+// Options controlling how (not what) OSM data is read
+struct OsmIngestOpts {
+  OsmIngestOpts()
+      : singlePass(false), memIdSet(false), sortMem(SORT_MEM_S), pool(0) {}
+
+  // read the OSM file in a single pass, buffering bounding box nodes and
+  // candidate ways in memory instead of re-reading the file four times
+  bool singlePass;
+
+  // keep the bounding box node id sets in memory (Elias-Fano encoded)
+  // instead of on disk
+  bool memIdSet;
+
+  // memory budget in bytes for sorting on-disk id sets
+  size_t sortMem;
+
+  // if not empty, finished graphs are stored as snapshots in this directory
+  // and reused by later runs with the same OSM file and options
+  std::string graphCacheDir;
+
+  // if not null, parallel stages run on the threads of this pool
+  ThreadPool* pool;
+};
+
 /*
  * Builds a physical transit network graph from OSM data
  */
 class OsmBuilder {
  public:
   OsmBuilder();
+  explicit OsmBuilder(const OsmIngestOpts& iOpts);
 
   // Read the OSM file at path, and write a graph to g. Only elements
   // inside the bounding box will be read
@@ -114,6 +181,16 @@ class OsmBuilder {
                 RelMap* wayRels, const OsmFilter& filter,
                 const AttrKeySet& keepAttrs, Restrictions* rests) const;
 
+  void readSinglePass(source::OsmSource* source, OsmIdSet* bBoxNodes,
+                      OsmIdSet* noHupNodes, const OsmFilter& filter,
+                      const BBoxIdx& bbox, const AttrKeySet attrKeys[3],
+                      OsmBuffer* buf, RelLst* rels, RelMap* nodeRels,
+                      RelMap* wayRels, Restrictions* rests) const;
+
+  void addRel(const OsmRel& rel, RelLst* rels, RelMap* nodeRels,
+              RelMap* wayRels, const OsmFilter& filter,
+              Restrictions* rests) const;
+
   void readRestr(const OsmRel& rel, Restrictions* rests,
                  const OsmFilter& filter) const;
 
@@ -124,6 +201,17 @@ class OsmBuilder {
                  const AttrKeySet& keepAttrs, const FlatRels& flatRels,
                  const OsmReadOpts& opts) const;
 
+  void readNodes(OsmBuffer* buf, const source::OsmSource* source, Graph* g,
+                 const RelLst& rels, const RelMap& nodeRels,
+                 const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+                 NIdMap* nodes, NIdMultMap* multNodes, NodeSet* orphanStations,
+                 const FlatRels& flatRels, const OsmReadOpts& opts) const;
+
+  void addNode(const OsmNode& nd, const source::OsmSource* source, Graph* g,
+               const RelLst& rels, const RelMap& nodeRels,
+               const OsmFilter& filter, NIdMap* nodes, NIdMultMap* multNodes,
+               NodeSet* orphanStations, const OsmReadOpts& opts) const;
+
   void readWriteNds(source::OsmSource* source, util::xml::XmlWriter* o,
                     const RelMap& nodeRels, const OsmFilter& filter,
                     const OsmIdSet& bBoxNodes, NIdMap* nodes,
@@ -144,6 +232,22 @@ class OsmBuilder {
                  Restrictor* restor, const FlatRels& flatRels,
                  EdgTracks* etracks, const OsmReadOpts& opts);
 
+  void readEdges(OsmBuffer* buf, const source::OsmSource* source, Graph* g,
+                 const RelLst& rels, const RelMap& wayRels,
+                 const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+                 NIdMap* nodes, NIdMultMap* multNodes,
+                 const OsmIdSet& noHupNodes, const Restrictions& rest,
+                 Restrictor* restor, const FlatRels& flatRels,
+                 EdgTracks* etracks, const OsmReadOpts& opts);
+
+  void addWay(const OsmWay& w, const source::OsmSource* source, Graph* g,
+              const RelLst& rels, const RelMap& wayRels,
+              const OsmFilter& filter, const OsmIdSet& bBoxNodes,
+              NIdMap* nodes, NIdMultMap* multNodes,
+              const OsmIdSet& noHupNodes, const Restrictions& rest,
+              Restrictor* restor, EdgTracks* etracks,
+              const OsmReadOpts& opts);
+
   void readEdges(source::OsmSource* source, const RelMap& wayRels,
                  const OsmFilter& filter, const OsmIdSet& bBoxNodes,
                  const AttrKeySet& keepAttrs, OsmIdList* ret, NIdMap* nodes,
@@ -181,7 +285,7 @@ class OsmBuilder {
   static void snapStats(const OsmReadOpts& opts, Graph* g, const BBoxIdx& bbox,
                         double gridSize, Restrictor* res,
                         const NodeSet& orphanStations);
-  static void writeGeoms(Graph* g, const OsmReadOpts& opts);
+  static void writeGeoms(Graph* g, const OsmReadOpts& opts, ThreadPool* pool);
   static void deleteOrphNds(Graph* g, const OsmReadOpts& opts);
   static double dist(const Node* a, const Node* b);
 
@@ -194,11 +298,16 @@ class OsmBuilder {
   static void collapseEdges(Graph* g);
   static void writeODirEdgs(Graph* g, Restrictor* restor);
   static void writeSelfEdgs(Graph* g);
-  static void writeOneWayPens(Graph* g, const OsmReadOpts& opts);
-  static void writeNoLinePens(Graph* g, const OsmReadOpts& opts);
+  // Write the wrong-direction and no-line cost penalties in a single sweep
+  static void writePens(Graph* g, const OsmReadOpts& opts, ThreadPool* pool);
   static void writeEdgeTracks(const EdgTracks& tracks);
-  static void simplifyGeoms(Graph* g);
-  static uint32_t writeComps(Graph* g, const OsmReadOpts& opts);
+  static void simplifyGeoms(Graph* g, ThreadPool* pool);
+  static uint32_t writeComps(Graph* g, const OsmReadOpts& opts,
+                             ThreadPool* pool);
+  // Call f(t, n) for each node n of g, the nodes are split into contiguous
+  // chunks, t is the number of the chunk
+  static void forEachNd(Graph* g, ThreadPool* pool,
+                        const std::function<void(size_t, Node*)>& f);
   static bool edgesSim(const Edge* a, const Edge* b);
   static const EdgePL& mergeEdgePL(Edge* a, Edge* b);
   static void getEdgCands(const POINT& s, EdgeCandPQ* ret, EdgeGrid* eg,
@@ -253,6 +362,8 @@ class OsmBuilder {
 
   static uint32_t costToInt(double c);
 
+  OsmIngestOpts _iOpts;
+
   std::map<TransitEdgeLine, TransitEdgeLine*> _lines;
   std::map<size_t, TransitEdgeLine*> _relLines;
 };
@@ -3,16 +3,21 @@
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
 #include <stdio.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <climits>
 #include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <iostream>
+#include <queue>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 #include "pfaedle/Def.h"
 #include "pfaedle/osm/OsmIdSet.h"
 #include "util/3rdparty/MurmurHash3.h"
@@ -23,8 +28,24 @@ size_t OsmIdSet::LOOKUPS = 0;
 size_t OsmIdSet::FLOOKUPS = 0;
 
 // _____________________________________________________________________________
-OsmIdSet::OsmIdSet()
-    : _closed(false),
+OsmIdSet::OsmIdSet() : OsmIdSet(ID_SET_DISK) {}
+
+// _____________________________________________________________________________
+OsmIdSet::OsmIdSet(OsmIdSetStorage storage) : OsmIdSet(storage, SORT_MEM_S) {}
+
+// _____________________________________________________________________________
+OsmIdSet::OsmIdSet(OsmIdSetStorage storage, size_t sortMem)
+    : OsmIdSet(storage, sortMem, 0) {}
+
+// _____________________________________________________________________________
+OsmIdSet::OsmIdSet(OsmIdSetStorage storage, size_t sortMem, ThreadPool* pool)
+    : _storage(storage),
+      _sortMem(sortMem),
+      _pool(pool),
+      _closed(false),
+      _file(-1),
+      _buffer(0),
+      _outBuffer(0),
       _sorted(true),
       _last(0),
       _smallest(-1),
@@ -32,7 +53,15 @@ OsmIdSet::OsmIdSet()
       _hasInv(false),
       _obufpos(0),
       _curBlock(-1),
-      _fsize(0) {
+      _bitset(0),
+      _bitsetNotIn(0),
+      _fsize(0),
+      _map(0) {
+  if (_storage == ID_SET_MEM) {
+    _memBuf.reserve(MEM_CHUNK_S);
+    return;
+  }
+
   _bitset = new std::bitset<BLOOMF_BITS>();
   _bitsetNotIn = new std::bitset<BLOOMF_BITS>();
   _file = openTmpFile();
@@ -43,6 +72,8 @@ OsmIdSet::OsmIdSet()
 
 // _____________________________________________________________________________
 OsmIdSet::~OsmIdSet() {
+  if (_map) munmap(const_cast<uint64_t*>(_map), _fsize);
+  if (_file > -1) ::close(_file);
   delete _bitset;
   delete _bitsetNotIn;
   delete[] _buffer;
@@ -53,6 +84,9 @@ OsmIdSet::~OsmIdSet() {
 void OsmIdSet::nadd(osmid id) {
   if (_closed) throw std::exception();
 
+  // only used to speed up the bloom filter check of disk-based sets
+  if (_storage == ID_SET_MEM) return;
+
   _hasInv = true;
 
   uint32_t h1, h2;
@@ -69,6 +103,11 @@ void OsmIdSet::nadd(osmid id) {
 void OsmIdSet::add(osmid id) {
   if (_closed) throw std::exception();
 
+  if (_storage == ID_SET_MEM) {
+    memAdd(id);
+    return;
+  }
+
   diskAdd(id);
 
   if (_last > id) _sorted = false;
@@ -104,6 +143,63 @@ void OsmIdSet::diskAdd(osmid id) {
   }
 }
 
+// _____________________________________________________________________________
+void OsmIdSet::memAdd(osmid id) {
+  // direct repetitions are dropped here, everything else on flush
+  if ((_memBuf.size() || _memChunks.size()) && _last == id) return;
+
+  if (_last > id) _sorted = false;
+  _last = id;
+  if (id < _smallest) _smallest = id;
+  if (id > _biggest) _biggest = id;
+
+  _memBuf.push_back(id);
+
+  if (_memBuf.size() >= MEM_CHUNK_S) memFlush();
+}
+
+// _____________________________________________________________________________
+void OsmIdSet::memFlush() const {
+  if (_memBuf.empty()) return;
+
+  if (!_sorted) {
+    // chunks may overlap now, they are merged by memSort() on close
+    std::sort(_memBuf.begin(), _memBuf.end());
+    _memBuf.erase(std::unique(_memBuf.begin(), _memBuf.end()), _memBuf.end());
+  }
+
+  _memChunks.emplace_back(&_memBuf.front(), &_memBuf.front() + _memBuf.size());
+  _blockEnds.push_back(_memBuf.back());
+  _memBuf.clear();
+}
+
+// _____________________________________________________________________________
+void OsmIdSet::memSort() const {
+  std::vector<osmid> ids;
+  for (const auto& c : _memChunks) c.decode(&ids);
+
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  _memChunks.clear();
+  _blockEnds.clear();
+
+  for (size_t i = 0; i < ids.size(); i += MEM_CHUNK_S) {
+    size_t end = std::min(ids.size(), i + MEM_CHUNK_S);
+    _memChunks.emplace_back(&ids[i], &ids[0] + end);
+    _blockEnds.push_back(ids[end - 1]);
+  }
+
+  _sorted = true;
+}
+
+// _____________________________________________________________________________
+bool OsmIdSet::memHas(osmid id) const {
+  auto it = std::lower_bound(_blockEnds.begin(), _blockEnds.end(), id);
+  if (it == _blockEnds.end()) return false;
+  return _memChunks[it - _blockEnds.begin()].has(id);
+}
+
 // _____________________________________________________________________________
 size_t OsmIdSet::getBlock(osmid id) const {
   auto it = std::upper_bound(_blockEnds.begin(), _blockEnds.end(), id);
@@ -121,6 +217,13 @@ bool OsmIdSet::diskHas(osmid id) const {
 
   size_t block = getBlock(id);
 
+  if (_map) {
+    // the sparse index already gave us the block, search the mapped ids in it
+    const uint64_t* beg = _map + std::min(block * BUFFER_S, _fsize) / 8;
+    const uint64_t* end = _map + std::min((block + 1) * BUFFER_S, _fsize) / 8;
+    return std::binary_search(beg, end, id);
+  }
+
   if (block != _curBlock) {
     lseek(_file, block * BUFFER_S, SEEK_SET);
 
@@ -159,6 +262,8 @@ bool OsmIdSet::has(osmid id) const {
     return false;
   }
 
+  if (_storage == ID_SET_MEM) return memHas(id);
+
   uint32_t h1, h2;
   MurmurHash3_x86_32(&id, 8, 469954432, &h1);
   h2 = jenkins(id);
@@ -179,6 +284,14 @@ bool OsmIdSet::has(osmid id) const {
 
 // _____________________________________________________________________________
 void OsmIdSet::close() const {
+  if (_storage == ID_SET_MEM) {
+    memFlush();
+    _memBuf.shrink_to_fit();
+    _closed = true;
+    if (!_sorted) memSort();
+    return;
+  }
+
   ssize_t w = cwrite(_file, _outBuffer, _obufpos);
   _fsize += w;
   _blockEnds.push_back(_biggest);
@@ -187,86 +300,164 @@ void OsmIdSet::close() const {
 
   // if order was not sorted, sort now
   if (!_sorted) sort();
+
+  map();
+}
+
+// _____________________________________________________________________________
+void OsmIdSet::map() const {
+  if (!_fsize) return;
+
+  void* m = mmap(0, _fsize, PROT_READ, MAP_SHARED, _file, 0);
+
+  // fall back to explicit reads into _buffer
+  if (m == MAP_FAILED) return;
+
+  // lookups are binary searches within single blocks, read-ahead would
+  // mostly fetch pages we never touch
+  madvise(m, _fsize, MADV_RANDOM);
+
+  _map = static_cast<const uint64_t*>(m);
 }
 
 // _____________________________________________________________________________
 void OsmIdSet::sort() const {
-  // sort file via an external merge sort
+  // sort file via an external merge sort: runs fitting into the memory budget
+  // are radix sorted in place by multiple threads, then merged into a new file
 
   _blockEnds.clear();
-  size_t parts = _fsize / SORT_BUFFER_S + 1;
-  size_t partsBufSize = ((SORT_BUFFER_S / 8) / parts + 1) * 8;
-
-  unsigned char* buf = new unsigned char[SORT_BUFFER_S];
-  unsigned char** partbufs = new unsigned char*[parts];
-  size_t* partpos = new size_t[parts];
-  size_t* partsize = new size_t[parts];
-
-  // sort the 'parts' number of file parts independently
-  for (size_t i = 0; i < parts; i++) {
-    partbufs[i] = new unsigned char[partsBufSize];
-    partpos[i] = 0;
-    partsize[i] = 0;
-    lseek(_file, SORT_BUFFER_S * i, SEEK_SET);
-    ssize_t n = read(_file, buf, SORT_BUFFER_S);
-    if (n < 0) continue;
-    qsort(buf, n / 8, 8, qsortCmp);
-    lseek(_file, SORT_BUFFER_S * i, SEEK_SET);
-    cwrite(_file, buf, n);
-
-    memcpy(partbufs[i], buf, std::min<size_t>(n, partsBufSize));
-    partsize[i] = n;
+
+  if (!_fsize) {
+    _sorted = true;
+    return;
   }
 
-  // now the individial parts are sorted
-  int newFile = openTmpFile();
+  // without a given pool, use a temporary one with a thread per core
+  std::unique_ptr<ThreadPool> tmpPool;
+  ThreadPool* pool = ThreadPool::getOrTmp(_pool, &tmpPool);
+
+  size_t numThreads = pool->getNumThreads();
+
+  // each thread holds a run and an equally sized radix sort buffer
+  size_t runSize =
+      std::max<size_t>(MIN_RUN_S, (_sortMem / (2 * numThreads)) / 8 * 8);
+  size_t numRuns = (_fsize + runSize - 1) / runSize;
+  numThreads = std::min(numThreads, numRuns);
 
-  for (size_t i = 0; i < _fsize; i += 8) {
-    uint64_t smallest = UINT64_MAX;
-    ssize_t smallestP = -1;
-
-    // look for smallest element (not optimal, but running time is not
-    // really critical here)
-    for (size_t j = 0; j < parts; j++) {
-      if (partpos[j] == partsize[j]) continue;  // bucket already empty
-      if (*reinterpret_cast<uint64_t*>(
-              &partbufs[j][partpos[j] % partsBufSize]) <= smallest) {
-        smallestP = j;
-        smallest = *reinterpret_cast<uint64_t*>(
-            &partbufs[j][partpos[j] % partsBufSize]);
-      }
+  std::atomic<size_t> nextRun(0);
+
+  pool->run(numThreads, [&](size_t) {
+    std::vector<uint64_t> run(runSize / 8), tmp(runSize / 8);
+    size_t i;
+    while ((i = nextRun++) < numRuns) {
+      size_t n = std::min(runSize, _fsize - i * runSize);
+      cpread(_file, run.data(), n, i * runSize);
+      radixSort(run.data(), tmp.data(), n / 8);
+      cpwrite(_file, run.data(), n, i * runSize);
     }
+  });
+
+  // k-way merge of the sorted runs, the budget is split evenly between the
+  // read buffers of the runs and the output buffer
+  size_t bufSize =
+      std::max<size_t>(MIN_MERGE_BUF_S, (_sortMem / (numRuns + 1)) / 8 * 8);
+
+  std::vector<std::vector<uint64_t>> bufs(numRuns);
+  std::vector<size_t> bufPos(numRuns, 0), bufLen(numRuns, 0);
+  std::vector<size_t> runPos(numRuns), runEnd(numRuns);
+
+  typedef std::pair<uint64_t, size_t> HeapEntry;
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+                      std::greater<HeapEntry>>
+      heap;
+
+  for (size_t i = 0; i < numRuns; i++) {
+    runPos[i] = i * runSize;
+    runEnd[i] = std::min(_fsize, (i + 1) * runSize);
+    bufs[i].resize(bufSize / 8);
+
+    size_t n = std::min(bufSize, runEnd[i] - runPos[i]);
+    cpread(_file, bufs[i].data(), n, runPos[i]);
+    runPos[i] += n;
+    bufLen[i] = n / 8;
+    heap.push({bufs[i][0], i});
+  }
+
+  int newFile = openTmpFile();
+  std::vector<uint64_t> out(bufSize / 8);
+  size_t outPos = 0;
+  size_t written = 0;
 
-    assert(smallestP > -1);
+  while (!heap.empty()) {
+    uint64_t id = heap.top().first;
+    size_t r = heap.top().second;
+    heap.pop();
 
-    memcpy(buf + (i % SORT_BUFFER_S), &smallest, 8);
+    out[outPos++] = id;
+    written++;
 
-    if ((i + 8) % BUFFER_S == 0) _blockEnds.push_back(smallest);
+    // this is the last value in this block
+    if (written % (BUFFER_S / 8) == 0) _blockEnds.push_back(id);
 
-    if ((i % SORT_BUFFER_S) == SORT_BUFFER_S - 8 || i == _fsize - 8) {
-      // write to output file
-      cwrite(newFile, buf, i % SORT_BUFFER_S + 8);
+    if (outPos == out.size()) {
+      cwrite(newFile, out.data(), outPos * 8);
+      outPos = 0;
     }
 
-    partpos[smallestP] += 8;
-
-    if (partpos[smallestP] % partsBufSize == 0) {
-      lseek(_file, SORT_BUFFER_S * smallestP + partpos[smallestP], SEEK_SET);
-      cread(_file, partbufs[smallestP], partsBufSize);
+    if (++bufPos[r] == bufLen[r]) {
+      // refill the run buffer
+      size_t n = std::min(bufSize, runEnd[r] - runPos[r]);
+      if (!n) continue;
+      cpread(_file, bufs[r].data(), n, runPos[r]);
+      runPos[r] += n;
+      bufLen[r] = n / 8;
+      bufPos[r] = 0;
     }
+
+    heap.push({bufs[r][bufPos[r]], r});
   }
 
-  // cleanup
-  delete[] buf;
-  for (size_t j = 0; j < parts; j++) delete[] partbufs[j];
-  delete[] partbufs;
-  delete[] partpos;
-  delete[] partsize;
+  cwrite(newFile, out.data(), outPos * 8);
 
+  ::close(_file);
   _file = newFile;
   _sorted = true;
 }
 
+// _____________________________________________________________________________
+void OsmIdSet::radixSort(uint64_t* a, uint64_t* tmp, size_t n) {
+  // LSD radix sort on bytes, all histograms are built in a single pass
+  if (!n) return;
+
+  uint64_t* ret = a;
+  size_t cnt[8][256] = {};
+
+  for (size_t i = 0; i < n; i++) {
+    for (size_t b = 0; b < 8; b++) cnt[b][(a[i] >> (b * 8)) & 0xff]++;
+  }
+
+  for (size_t b = 0; b < 8; b++) {
+    // skip bytes which are equal for all ids, for OSM ids this is usually
+    // true for the upper half
+    if (cnt[b][(a[0] >> (b * 8)) & 0xff] == n) continue;
+
+    size_t sum = 0;
+    for (size_t j = 0; j < 256; j++) {
+      size_t c = cnt[b][j];
+      cnt[b][j] = sum;
+      sum += c;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      tmp[cnt[b][(a[i] >> (b * 8)) & 0xff]++] = a[i];
+    }
+
+    std::swap(a, tmp);
+  }
+
+  if (a != ret) memcpy(ret, a, n * 8);
+}
+
 // _____________________________________________________________________________
 size_t OsmIdSet::cwrite(int f, const void* buf, size_t n) const {
   ssize_t w = write(f, buf, n);
@@ -287,6 +478,35 @@ size_t OsmIdSet::cread(int f, void* buf, size_t n) const {
   return w;
 }
 
+// _____________________________________________________________________________
+size_t OsmIdSet::cpwrite(int f, const void* buf, size_t n, size_t off) const {
+  size_t done = 0;
+  while (done < n) {
+    ssize_t w = pwrite(f, static_cast<const char*>(buf) + done, n - done,
+                       off + done);
+    if (w <= 0) {
+      throw std::runtime_error("Could not write to tmp file.\n");
+    }
+    done += w;
+  }
+
+  return done;
+}
+
+// _____________________________________________________________________________
+size_t OsmIdSet::cpread(int f, void* buf, size_t n, size_t off) const {
+  size_t done = 0;
+  while (done < n) {
+    ssize_t w = pread(f, static_cast<char*>(buf) + done, n - done, off + done);
+    if (w <= 0) {
+      throw std::runtime_error("Could not read from tmp file.\n");
+    }
+    done += w;
+  }
+
+  return done;
+}
+
 // _____________________________________________________________________________
 uint32_t OsmIdSet::knuth(uint32_t in) const {
   const uint32_t a = 2654435769;
@@ -11,6 +11,8 @@
 #include <set>
 #include <string>
 #include <vector>
+#include "pfaedle/ThreadPool.h"
+#include "pfaedle/osm/EliasFano.h"
 #include "pfaedle/osm/Osm.h"
 
 #ifndef POSIX_FADV_SEQUENTIAL
@@ -22,18 +24,40 @@ namespace osm {
 
 // buffer sizes _must_ be multiples of 8
 static const size_t BUFFER_S = 8 * 64 * 1024;
-static const size_t SORT_BUFFER_S = 8 * 64 * 1024;
 static const size_t OBUFFER_S = 8 * 1024 * 1024;
 
+// default memory budget for sorting disk-based sets
+static const size_t SORT_MEM_S = 256 * 1024 * 1024;
+
+// lower bounds for the sort run and merge buffer sizes, regardless of budget
+static const size_t MIN_RUN_S = 8 * 128 * 1024;
+static const size_t MIN_MERGE_BUF_S = 8 * 8 * 1024;
+
 #define BLOOMF_BITS 214748357
 
+// number of ids per Elias-Fano chunk of in-memory sets
+static const size_t MEM_CHUNK_S = 16 * 1024;
+
+// storage backend of an OsmIdSet
+enum OsmIdSetStorage { ID_SET_DISK, ID_SET_MEM };
+
 /*
- * A disk-based set for OSM ids. Read-access for checking the presence is
- * reduced by a bloom filter
+ * A set for OSM ids. Per default, the ids are stored on disk and read-access
+ * for checking the presence is reduced by a bloom filter. Once the set is
+ * closed, the sorted file is memory mapped. Alternatively, the
+ * ids may be kept in memory as a sequence of Elias-Fano encoded chunks.
  */
 class OsmIdSet {
  public:
   OsmIdSet();
+  explicit OsmIdSet(OsmIdSetStorage storage);
+
+  // sortMem is the memory budget (in bytes) used for sorting unsorted
+  // disk-based sets
+  OsmIdSet(OsmIdSetStorage storage, size_t sortMem);
+
+  // Same as above, sorting runs on the threads of pool
+  OsmIdSet(OsmIdSetStorage storage, size_t sortMem, ThreadPool* pool);
   ~OsmIdSet();
 
   // Add an OSM id
@@ -50,6 +74,9 @@ class OsmIdSet {
   static size_t FLOOKUPS;
 
  private:
+  OsmIdSetStorage _storage;
+  size_t _sortMem;
+  ThreadPool* _pool;
   std::string _tmpPath;
   mutable bool _closed;
   mutable int _file;
@@ -75,25 +102,34 @@ class OsmIdSet {
 
   mutable size_t _fsize;
 
+  // read-only mapping of the sorted tmp file, 0 if not mapped
+  mutable const uint64_t* _map;
+
+  // in-memory storage: ids not yet encoded, and the encoded chunks. For
+  // in-memory sets, _blockEnds holds the largest id of each chunk
+  mutable std::vector<osmid> _memBuf;
+  mutable std::vector<EliasFano> _memChunks;
+
   uint32_t knuth(uint32_t in) const;
   uint32_t jenkins(uint32_t in) const;
   void diskAdd(osmid id);
+  void memAdd(osmid id);
+  void memFlush() const;
+  void memSort() const;
+  bool memHas(osmid id) const;
   void close() const;
   void sort() const;
   bool diskHas(osmid id) const;
+  void map() const;
   std::string getFName() const;
   size_t getBlock(osmid id) const;
   int openTmpFile() const;
   size_t cwrite(int f, const void* buf, size_t n) const;
   size_t cread(int f, void* buf, size_t n) const;
+  size_t cpwrite(int f, const void* buf, size_t n, size_t off) const;
+  size_t cpread(int f, void* buf, size_t n, size_t off) const;
 
-  static int qsortCmp(const void* a, const void* b) {
-    if (*static_cast<const uint64_t*>(a) < *static_cast<const uint64_t*>(b))
-      return -1;
-    if (*static_cast<const uint64_t*>(a) > *static_cast<const uint64_t*>(b))
-      return 1;
-    return 0;
-  }
+  static void radixSort(uint64_t* a, uint64_t* tmp, size_t n);
 };
 }  // namespace osm
 }  // namespace pfaedle
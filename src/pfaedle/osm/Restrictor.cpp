@@ -49,6 +49,15 @@ void Restrictor::add(const trgraph::Edge* from, osmid to,
   }
 }
 
+// _____________________________________________________________________________
+void Restrictor::addRule(const trgraph::Edge* from, const trgraph::Edge* to,
+                         const trgraph::Node* via, bool pos) {
+  if (pos)
+    _pos[via].push_back(RulePair(from, to));
+  else
+    _neg[via].push_back(RulePair(from, to));
+}
+
 // _____________________________________________________________________________
 bool Restrictor::may(const trgraph::Edge* from, const trgraph::Edge* to,
                      const trgraph::Node* via) const {
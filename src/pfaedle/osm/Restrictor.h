@@ -42,6 +42,13 @@ class Restrictor {
                      const trgraph::Edge* newE);
   void duplicateEdge(const trgraph::Edge* old, const trgraph::Edge* newE);
 
+  // Add an already resolved rule, used to restore graph snapshots
+  void addRule(const trgraph::Edge* from, const trgraph::Edge* to,
+               const trgraph::Node* via, bool pos);
+
+  const Rules& getPosRules() const { return _pos; }
+  const Rules& getNegRules() const { return _neg; }
+
  private:
   Rules _pos;
   Rules _neg;
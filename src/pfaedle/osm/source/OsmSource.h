@@ -6,7 +6,9 @@
 #define PFAEDLE_OSM_SOURCE_OSMSOURCE_H_
 
 #include <stdint.h>
+#include <string>
 #include <vector>
+#include "pfaedle/osm/Osm.h"
 #include "util/geo/Geo.h"
 
 namespace pfaedle {
@@ -38,6 +40,30 @@ struct OsmSourceRelationMember {
   const char* role;
 };
 
+/*
+ * Read-only predicates a source may evaluate ahead of time, possibly from
+ * several threads at once, to skip entities the consumer would drop anyway.
+ * They must only check necessary conditions, entities which are kept are
+ * still checked by the consumer. Attribute maps only hold the keys for which
+ * wantsKey() returned true. Entity types are 0 (node), 1 (way) and
+ * 2 (relation).
+ */
+class OsmSourcePrefilter {
+ public:
+  virtual ~OsmSourcePrefilter() {}
+  virtual bool wantsKey(uint8_t type, const char* key) const = 0;
+  virtual bool keepNode(uint64_t id, const AttrMap& attrs) const = 0;
+  virtual bool keepWay(uint64_t id, size_t numNodes,
+                       const AttrMap& attrs) const = 0;
+  virtual bool keepRel(uint64_t id, const AttrMap& attrs) const = 0;
+};
+
+/*
+ * Sequential access to the entities of an OSM file. nextNode(), nextWay()
+ * and nextRel() return 0 as soon as the respective entity block has ended,
+ * so nodes, ways and relations may be consumed one after the other without
+ * seeking.
+ */
 class OsmSource {
  public:
   virtual const OsmSourceNode* nextNode() = 0;
@@ -58,6 +84,11 @@ class OsmSource {
 
   virtual std::string decode(const char* str) const = 0;
   virtual std::string decode(const std::string& str) const = 0;
+
+  // Set a prefilter (or 0 to disable it). Sources are free to ignore it. A
+  // new prefilter takes effect on the first read after construction or after
+  // the next seek, and must outlive the reads it is used for.
+  virtual void setPrefilter(const OsmSourcePrefilter*) {}
 };
 
 }  // namespace source
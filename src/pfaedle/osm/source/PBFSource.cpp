@@ -7,9 +7,11 @@
 #include <cassert>
 #include <fstream>
 
+#include "pfaedle/ThreadPool.h"
 #include "pfaedle/osm/source/PBFSource.h"
 #include "util/log/Log.h"
 
+using pfaedle::ThreadPool;
 using pfaedle::osm::source::PBFSource;
 using pfaedle::osm::source::OsmSourceNode;
 using pfaedle::osm::source::OsmSourceAttr;
@@ -19,8 +21,22 @@ using pfaedle::osm::source::OsmSourceRelationMember;
 
 // _____________________________________________________________________________
 PBFSource::PBFSource(const std::string& path)
+    : PBFSource(path, ThreadPool::getNumCpus()) {}
+
+// _____________________________________________________________________________
+PBFSource::PBFSource(const std::string& path, size_t numWorkers)
     : _path(path),
-      _buffer(),
+      _numWorkers(numWorkers ? numWorkers : 1),
+      _prefilter(0),
+      _nextPrefilter(0),
+      _minRank(0),
+      _inFlight(0),
+      _numRead(0),
+      _nextSeq(0),
+      _running(false),
+      _eof(false),
+      _stop(false),
+      _blockPos(0),
       _curNode(nullptr),
       _curWay(nullptr),
       _curRel(nullptr) {
@@ -45,12 +61,11 @@ PBFSource::PBFSource(const std::string& path)
       util::geo::Point<double>(180.0, 90.0)
     );
   }
-  
-  readNextBuffer();
 }
 
 // _____________________________________________________________________________
 PBFSource::~PBFSource() {
+  stopPipeline();
   if (_reader) {
     _reader->close();
   }
@@ -63,47 +78,212 @@ void PBFSource::initReader() {
 }
 
 // _____________________________________________________________________________
-void PBFSource::readNextBuffer() {
-  if (_reader) {
-    _buffer = _reader->read();
-    if (_buffer) {
-      _bufferIt = _buffer.begin();
+void PBFSource::setPrefilter(const OsmSourcePrefilter* f) {
+  _nextPrefilter = f;
+}
+
+// _____________________________________________________________________________
+void PBFSource::startPipeline() {
+  _prefilter = _nextPrefilter;
+  _inFlight = 0;
+  _numRead = 0;
+  _nextSeq = 0;
+  _eof = false;
+  _stop = false;
+  _err = nullptr;
+
+  _producer = std::thread(&PBFSource::produce, this);
+  for (size_t i = 0; i < _numWorkers; i++) {
+    _workers.emplace_back(&PBFSource::work, this);
+  }
+
+  _running = true;
+}
+
+// _____________________________________________________________________________
+void PBFSource::stopPipeline() {
+  if (!_running) return;
+
+  {
+    std::unique_lock<std::mutex> lock(_mut);
+    _stop = true;
+  }
+
+  _prodCv.notify_all();
+  _workCv.notify_all();
+  _consCv.notify_all();
+
+  _producer.join();
+  for (auto& t : _workers) t.join();
+  _workers.clear();
+
+  _todo.clear();
+  _ready.clear();
+  _block = Block();
+  _blockPos = 0;
+  _running = false;
+}
+
+// _____________________________________________________________________________
+void PBFSource::produce() {
+  // at most this many buffers are decoded ahead of the consumer
+  size_t maxInFlight = 4 * _numWorkers;
+  size_t seq = 0;
+
+  try {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(_mut);
+        _prodCv.wait(lock, [&] { return _stop || _inFlight < maxInFlight; });
+        if (_stop) return;
+      }
+
+      osmium::memory::Buffer buf = _reader->read();
+
+      std::unique_lock<std::mutex> lock(_mut);
+      if (!buf) break;
+      _todo.emplace_back(seq++, std::move(buf));
+      _inFlight++;
+      _workCv.notify_one();
     }
+  } catch (...) {
+    std::unique_lock<std::mutex> lock(_mut);
+    _err = std::current_exception();
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(_mut);
+    _eof = true;
+    _numRead = seq;
   }
+
+  _workCv.notify_all();
+  _consCv.notify_all();
 }
 
 // _____________________________________________________________________________
-void PBFSource::advanceToNextEntity(osmium::item_type type) {
-  // Check if we need a new buffer
-  while (!_buffer || _bufferIt == _buffer.end()) {
-    readNextBuffer();
-    if (!_buffer || _buffer.committed() == 0) {
-      return;
+void PBFSource::work() {
+  while (true) {
+    std::pair<size_t, osmium::memory::Buffer> job;
+
+    {
+      std::unique_lock<std::mutex> lock(_mut);
+      _workCv.wait(lock, [this] { return _stop || _eof || !_todo.empty(); });
+      if (_stop || _todo.empty()) return;
+      job = std::move(_todo.front());
+      _todo.pop_front();
     }
+
+    Block b;
+    b.buf = std::move(job.second);
+    filterBlock(&b);
+
+    {
+      std::unique_lock<std::mutex> lock(_mut);
+      _ready[job.first] = std::move(b);
+    }
+
+    _consCv.notify_one();
   }
-  
-  // Find the next entity of the requested type
-  while (_bufferIt != _buffer.end() && _bufferIt->type() != type) {
-    ++_bufferIt;
-    while (!_buffer || _bufferIt == _buffer.end()) {
-      readNextBuffer();
-      if (!_buffer || _buffer.committed() == 0) {
-        return;
+}
+
+// _____________________________________________________________________________
+void PBFSource::filterBlock(Block* b) const {
+  AttrMap attrs;
+
+  for (auto it = b->buf.begin(); it != b->buf.end(); ++it) {
+    int rank = typeRank(it->type());
+    if (rank < _minRank) continue;
+
+    if (_prefilter) {
+      const auto& obj = static_cast<const osmium::OSMObject&>(*it);
+      attrs.clear();
+      for (const auto& tag : obj.tags()) {
+        if (_prefilter->wantsKey(rank, tag.key()))
+          attrs[tag.key()] = tag.value();
       }
+
+      if (rank == 0 && !_prefilter->keepNode(obj.id(), attrs)) continue;
+      if (rank == 1 &&
+          !_prefilter->keepWay(
+              obj.id(), static_cast<const osmium::Way&>(obj).nodes().size(),
+              attrs))
+        continue;
+      if (rank == 2 && !_prefilter->keepRel(obj.id(), attrs)) continue;
     }
+
+    b->ents.push_back(&*it);
+  }
+}
+
+// _____________________________________________________________________________
+bool PBFSource::nextBlock() {
+  if (!_running) startPipeline();
+
+  std::unique_lock<std::mutex> lock(_mut);
+  _consCv.wait(lock, [this] {
+    return _ready.count(_nextSeq) || (_eof && _nextSeq >= _numRead);
+  });
+
+  auto it = _ready.find(_nextSeq);
+
+  if (it == _ready.end()) {
+    if (_err) std::rethrow_exception(_err);
+    return false;
+  }
+
+  _block = std::move(it->second);
+  _blockPos = 0;
+  _ready.erase(it);
+  _nextSeq++;
+  _inFlight--;
+
+  lock.unlock();
+  _prodCv.notify_one();
+
+  return true;
+}
+
+// _____________________________________________________________________________
+int PBFSource::typeRank(osmium::item_type type) {
+  switch (type) {
+    case osmium::item_type::node:
+      return 0;
+    case osmium::item_type::way:
+      return 1;
+    case osmium::item_type::relation:
+      return 2;
+    default:
+      return -1;
+  }
+}
+
+// _____________________________________________________________________________
+bool PBFSource::advanceToNextEntity(osmium::item_type type) {
+  // PBF files are ordered by entity type (nodes, ways, relations), so as soon
+  // as an entity of a later type is reached, the requested block has ended.
+  // The position is left on that entity, which allows consuming the file
+  // block by block in a single sequential pass.
+  while (true) {
+    while (_blockPos == _block.ents.size()) {
+      if (!nextBlock()) return false;
+    }
+
+    auto cur = _block.ents[_blockPos]->type();
+    if (cur == type) return true;
+    if (typeRank(cur) > typeRank(type)) return false;
+
+    _blockPos++;
   }
 }
 
 // _____________________________________________________________________________
 const OsmSourceNode* PBFSource::nextNode() {
-  advanceToNextEntity(osmium::item_type::node);
-  
-  if (!_buffer || _bufferIt == _buffer.end()) {
+  if (!advanceToNextEntity(osmium::item_type::node)) {
     return nullptr;
   }
   
-  _curNode = &static_cast<const osmium::Node&>(*_bufferIt);
-  ++_bufferIt;
+  _curNode = static_cast<const osmium::Node*>(_block.ents[_blockPos++]);
   
   _retNode.id = _curNode->id();
   _retNode.lat = _curNode->location().lat();
@@ -152,14 +332,12 @@ const OsmSourceAttr PBFSource::nextAttr() {
 
 // _____________________________________________________________________________
 const OsmSourceWay* PBFSource::nextWay() {
-  advanceToNextEntity(osmium::item_type::way);
-  
-  if (!_buffer || _bufferIt == _buffer.end()) {
+  if (!advanceToNextEntity(osmium::item_type::way)) {
     return nullptr;
   }
   
-  _curWay = &static_cast<const osmium::Way&>(*_bufferIt);
-  ++_bufferIt;
+  _curNode = nullptr;
+  _curWay = static_cast<const osmium::Way*>(_block.ents[_blockPos++]);
   
   _retWay.id = _curWay->id();
   
@@ -209,14 +387,13 @@ const OsmSourceRelationMember* PBFSource::nextMember() {
 
 // _____________________________________________________________________________
 const OsmSourceRelation* PBFSource::nextRel() {
-  advanceToNextEntity(osmium::item_type::relation);
-  
-  if (!_buffer || _bufferIt == _buffer.end()) {
+  if (!advanceToNextEntity(osmium::item_type::relation)) {
     return nullptr;
   }
   
-  _curRel = &static_cast<const osmium::Relation&>(*_bufferIt);
-  ++_bufferIt;
+  _curNode = nullptr;
+  _curWay = nullptr;
+  _curRel = static_cast<const osmium::Relation*>(_block.ents[_blockPos++]);
   
   _retRel.id = _curRel->id();
   
@@ -229,55 +406,27 @@ const OsmSourceRelation* PBFSource::nextRel() {
 }
 
 // _____________________________________________________________________________
-void PBFSource::seekNodes() {
+void PBFSource::seek(int minRank) {
+  stopPipeline();
   _reader->close();
   initReader();
-  readNextBuffer();
-  
+
+  // entities of earlier types are already skipped by the workers
+  _minRank = minRank;
+
   _curNode = nullptr;
   _curWay = nullptr;
   _curRel = nullptr;
 }
 
 // _____________________________________________________________________________
-void PBFSource::seekWays() {
-  seekNodes();
-  
-  while (_buffer && (_bufferIt != _buffer.end() || _buffer.committed() > 0)) {
-    if (_bufferIt == _buffer.end()) {
-      readNextBuffer();
-      if (!_buffer || _buffer.committed() == 0) break;
-    }
-    if (_bufferIt->type() == osmium::item_type::way) {
-      break;
-    }
-    ++_bufferIt;
-  }
-  
-  _curNode = nullptr;
-  _curWay = nullptr;
-  _curRel = nullptr;
-}
+void PBFSource::seekNodes() { seek(0); }
 
 // _____________________________________________________________________________
-void PBFSource::seekRels() {
-  seekNodes();
-  
-  while (_buffer && (_bufferIt != _buffer.end() || _buffer.committed() > 0)) {
-    if (_bufferIt == _buffer.end()) {
-      readNextBuffer();
-      if (!_buffer || _buffer.committed() == 0) break;
-    }
-    if (_bufferIt->type() == osmium::item_type::relation) {
-      break;
-    }
-    ++_bufferIt;
-  }
-  
-  _curNode = nullptr;
-  _curWay = nullptr;
-  _curRel = nullptr;
-}
+void PBFSource::seekWays() { seek(1); }
+
+// _____________________________________________________________________________
+void PBFSource::seekRels() { seek(2); }
 
 // _____________________________________________________________________________
 util::geo::Box<double> PBFSource::getBounds() {
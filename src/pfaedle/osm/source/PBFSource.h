@@ -5,9 +5,16 @@
 #ifndef PFAEDLE_OSM_SOURCE_PBFSOURCE_H_
 #define PFAEDLE_OSM_SOURCE_PBFSOURCE_H_
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
 #include <memory>
-#include <vector>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <osmium/io/any_input.hpp>
 #include <osmium/io/reader.hpp>
 #include <osmium/osm/node.hpp>
@@ -22,11 +29,18 @@ namespace pfaedle {
 namespace osm {
 namespace source {
 
+/*
+ * OSM source for PBF files. Buffers are read in file order by a producer
+ * thread, a pool of workers extracts the entities of each buffer (applying
+ * the prefilter, if set) and the consumer picks up the filtered buffers again
+ * in file order.
+ */
 class PBFSource : public OsmSource {
  public:
-  PBFSource(const std::string& path);
+  explicit PBFSource(const std::string& path);
+  PBFSource(const std::string& path, size_t numWorkers);
   virtual ~PBFSource();
-  
+
   virtual const OsmSourceNode* nextNode();
   virtual const OsmSourceAttr nextAttr();
   virtual const OsmSourceWay* nextWay();
@@ -44,34 +58,77 @@ class PBFSource : public OsmSource {
   virtual std::string decode(const char* str) const;
   virtual std::string decode(const std::string& str) const;
 
+  virtual void setPrefilter(const OsmSourcePrefilter* f);
+
  private:
+  // a decoded buffer, together with the entities in it which survived the
+  // type and prefilter checks
+  struct Block {
+    osmium::memory::Buffer buf;
+    std::vector<const osmium::memory::Item*> ents;
+  };
+
   std::string _path;
   std::unique_ptr<osmium::io::Reader> _reader;
-  osmium::memory::Buffer _buffer;
-  osmium::memory::Buffer::iterator _bufferIt;
-  
+
+  size_t _numWorkers;
+
+  // prefilter and minimum entity type rank used by the running pipeline,
+  // only changed while the pipeline is stopped
+  const OsmSourcePrefilter* _prefilter;
+  const OsmSourcePrefilter* _nextPrefilter;
+  int _minRank;
+
+  // pipeline state, guarded by _mut
+  std::thread _producer;
+  std::vector<std::thread> _workers;
+  std::mutex _mut;
+  std::condition_variable _prodCv;
+  std::condition_variable _workCv;
+  std::condition_variable _consCv;
+  std::deque<std::pair<size_t, osmium::memory::Buffer>> _todo;
+  std::map<size_t, Block> _ready;
+  size_t _inFlight;
+  size_t _numRead;
+  size_t _nextSeq;
+  bool _running;
+  bool _eof;
+  bool _stop;
+  std::exception_ptr _err;
+
+  Block _block;
+  size_t _blockPos;
+
   const osmium::Node* _curNode;
   const osmium::Way* _curWay;
   const osmium::Relation* _curRel;
-  
+
   osmium::TagList::const_iterator _curTagIt;
   osmium::TagList::const_iterator _curTagEnd;
   osmium::WayNodeList::const_iterator _curWayNodeIt;
   osmium::WayNodeList::const_iterator _curWayNodeEnd;
   osmium::RelationMemberList::const_iterator _curRelMemberIt;
   osmium::RelationMemberList::const_iterator _curRelMemberEnd;
-  
+
   OsmSourceNode _retNode;
   OsmSourceWay _retWay;
   OsmSourceRelation _retRel;
   OsmSourceRelationMember _retMember;
   OsmSourceAttr _retAttr;
-  
+
   util::geo::Box<double> _bbox;
-  
-  void readNextBuffer();
-  void advanceToNextEntity(osmium::item_type type);
+
+  bool advanceToNextEntity(osmium::item_type type);
+  static int typeRank(osmium::item_type type);
   void initReader();
+  void seek(int minRank);
+
+  void startPipeline();
+  void stopPipeline();
+  bool nextBlock();
+  void produce();
+  void work();
+  void filterBlock(Block* b) const;
 };
 
 }  // namespace source
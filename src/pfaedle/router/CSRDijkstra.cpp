@@ -0,0 +1,6 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#include "pfaedle/router/CSRDijkstra.h"
+
+std::atomic<size_t> pfaedle::router::CSRDijkstra::ITERS(0);
@@ -0,0 +1,186 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_ROUTER_CSRDIJKSTRA_H_
+#define PFAEDLE_ROUTER_CSRDIJKSTRA_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pfaedle/trgraph/CSRGraph.h"
+
+namespace pfaedle {
+namespace router {
+
+/*
+ * Edge-based Dijkstra (or A*) on a CSR view of the transit graph. Like
+ * util::graph::EDijkstra, the cost of a path is the sum of the costs of the
+ * turns along it, where a turn is charged with the cost of the edge it
+ * leaves; the cost of the target edge itself is not included.
+ *
+ * The cost function must provide
+ *   uint32_t operator()(const trgraph::CSRGraph&, uint32_t fr, uint32_t to)
+ *   uint32_t inf()
+ * the heuristic
+ *   uint32_t operator()(const trgraph::CSRGraph&, uint32_t e)
+ */
+class CSRDijkstra {
+ public:
+  // Calculate the shortest paths from edge from to each edge in tos. The
+  // cost to tos[i] is written to (*costs)[i], costF.inf() if tos[i] cannot
+  // be reached below that. If paths is not null, (*paths)[i] holds the
+  // edges on the path to tos[i], starting with tos[i] itself, and is empty
+  // if no path was found. The search state is kept in a per-thread
+  // workspace, so apart from growing costs and paths to their needed size,
+  // no memory is allocated once the workspace is warm.
+  template <typename CF, typename HF>
+  static void shortestPath(const trgraph::CSRGraph& g, uint32_t from,
+                           const std::vector<uint32_t>& tos, const CF& costF,
+                           const HF& heurF, std::vector<uint32_t>* costs,
+                           std::vector<std::vector<uint32_t>>* paths);
+
+  // Calculate the shortest path from edge from to edge to with a
+  // bidirectional A*. heurTo estimates the cost from an edge to to, heurFrom
+  // the cost from from to an edge. Both searches use the average of the two
+  // as their potential, which keeps it consistent for both directions, and
+  // stop once no path through an unsettled edge can be cheaper than the
+  // best one found. Returns the cost, costF.inf() if there is no path below
+  // it. If path is not null, the edges on the path are written to it,
+  // starting with to.
+  template <typename CF, typename HF>
+  static uint32_t shortestPathBidir(const trgraph::CSRGraph& g, uint32_t from,
+                                    uint32_t to, const CF& costF,
+                                    const HF& heurTo, const HF& heurFrom,
+                                    std::vector<uint32_t>* path);
+
+  // Calculate the shortest paths from each edge in froms to each edge in
+  // tos in a single pass. Forward searches from all froms and backward
+  // searches from all tos are run simultaneously and meet in the middle, so
+  // each of them only has to cover about half of the distance. The cost
+  // from froms[i] to tos[j] is written to (*costs)[i * |tos| + j], the path
+  // (if paths is not null) to the same position in paths. heurTo must
+  // underestimate the cost from an edge to the nearest edge in tos, heurFrom
+  // the cost from the nearest edge in froms to an edge. They are not used
+  // as potentials, but edges which cannot lie on a path cheaper than
+  // costF.inf() are never settled, so pairs without such a path only cost
+  // the area an A* search would explore for them.
+  template <typename CF, typename HF>
+  static void shortestPaths(const trgraph::CSRGraph& g,
+                            const std::vector<uint32_t>& froms,
+                            const std::vector<uint32_t>& tos, const CF& costF,
+                            const HF& heurTo, const HF& heurFrom,
+                            std::vector<uint32_t>* costs,
+                            std::vector<std::vector<uint32_t>>* paths);
+
+  // Number of edges settled by all searches so far, like EDijkstra::ITERS
+  static std::atomic<size_t> ITERS;
+
+ private:
+  // Counts the edges settled by a single search and adds them to ITERS
+  // once the search is finished, so the shared counter is only touched once
+  // per search
+  struct IterCount {
+    IterCount() : n(0) {}
+    ~IterCount() { ITERS += n; }
+    size_t n;
+  };
+
+  struct PQEntry {
+    uint64_t prio;
+    uint32_t d;
+    uint32_t e;
+    uint32_t pred;
+  };
+
+  // 4-ary min heap on PQEntry::prio. It is shallower than a binary heap,
+  // and clearing it keeps its memory for the next search
+  class QuadHeap {
+   public:
+    bool empty() const { return _h.empty(); }
+    void clear() { _h.clear(); }
+    const PQEntry& top() const { return _h.front(); }
+    void push(const PQEntry& v);
+    void pop();
+
+   private:
+    std::vector<PQEntry> _h;
+  };
+
+  struct Label {
+    uint32_t gen;
+    uint32_t pred;
+  };
+
+  // Search state of the single source searches of one thread. A label is
+  // only valid if its generation is the one of the current search, so the
+  // state is reset in O(1). Takes 8 bytes per edge of the graph.
+  struct Workspace {
+    Workspace() : gen(0) {}
+    uint32_t gen;
+    std::vector<Label> settled;
+    QuadHeap pq;
+
+    // (edge id, position in tos), sorted by edge id
+    std::vector<std::pair<uint32_t, size_t>> tgts;
+  };
+
+  // Return the workspace of the calling thread, prepared for a new search
+  // on g
+  static Workspace* getWorkspace(const trgraph::CSRGraph& g);
+
+  struct BiLabel {
+    uint32_t gen;
+    uint32_t pred;
+    uint32_t d;
+  };
+
+  // Search state of the bidirectional searches of one thread, like
+  // Workspace. pred is the successor in the backward search. Takes 24
+  // bytes per edge of the graph.
+  struct BiWorkspace {
+    BiWorkspace() : gen(0) {}
+    uint32_t gen;
+    std::vector<BiLabel> fw, bw;
+    QuadHeap fwPq, bwPq;
+  };
+
+  static BiWorkspace* getBiWorkspace(const trgraph::CSRGraph& g);
+
+  struct MPQEntry {
+    uint32_t d;
+    uint32_t e;
+    uint32_t pred;
+    uint32_t search;
+
+    bool operator>(const MPQEntry& o) const { return d > o.d; }
+  };
+
+  typedef std::priority_queue<MPQEntry, std::vector<MPQEntry>,
+                              std::greater<MPQEntry>>
+      MPQ;
+
+  // maps settled edges to their cost and predecessor (forward) or
+  // successor (backward)
+  typedef std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>>
+      SettledCost;
+
+  static void buildPath(const SettledCost& fw, const SettledCost& bw,
+                        uint32_t x, uint32_t y, std::vector<uint32_t>* path);
+
+  static void meet(size_t i, size_t j, size_t numTos, uint64_t c, uint32_t x,
+                   uint32_t y, std::vector<uint32_t>* costs,
+                   std::vector<std::pair<uint32_t, uint32_t>>* meets);
+
+  static void buildPath(uint32_t e, const Workspace& ws,
+                        std::vector<uint32_t>* path);
+};
+
+#include "pfaedle/router/CSRDijkstra.tpp"
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_CSRDIJKSTRA_H_
@@ -0,0 +1,460 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+// _____________________________________________________________________________
+template <typename CF, typename HF>
+void CSRDijkstra::shortestPath(const trgraph::CSRGraph& g, uint32_t from,
+                               const std::vector<uint32_t>& tos,
+                               const CF& costF, const HF& heurF,
+                               std::vector<uint32_t>* costs,
+                               std::vector<std::vector<uint32_t>>* paths) {
+  costs->assign(tos.size(), costF.inf());
+  if (paths) {
+    // keep the capacity of path buffers of earlier searches
+    paths->resize(tos.size());
+    for (auto& p : *paths) p.clear();
+  }
+
+  if (tos.empty()) return;
+
+  Workspace* ws = getWorkspace(g);
+  IterCount iters;
+
+  ws->tgts.clear();
+  for (size_t i = 0; i < tos.size(); i++) ws->tgts.push_back({tos[i], i});
+  std::sort(ws->tgts.begin(), ws->tgts.end());
+
+  size_t remaining = 0;
+  for (size_t i = 0; i < ws->tgts.size(); i++) {
+    if (i == 0 || ws->tgts[i].first != ws->tgts[i - 1].first) remaining++;
+  }
+
+  ws->pq.push({heurF(g, from), 0, from, trgraph::CSRGraph::NO_ID});
+
+  while (!ws->pq.empty()) {
+    const PQEntry cur = ws->pq.top();
+    ws->pq.pop();
+
+    Label& l = ws->settled[cur.e];
+    if (l.gen == ws->gen) continue;
+    l.gen = ws->gen;
+    l.pred = cur.pred;
+    iters.n++;
+
+    auto t = std::lower_bound(ws->tgts.begin(), ws->tgts.end(),
+                              std::make_pair(cur.e, size_t(0)));
+    if (t != ws->tgts.end() && t->first == cur.e) {
+      for (; t != ws->tgts.end() && t->first == cur.e; ++t) {
+        (*costs)[t->second] = cur.d;
+        if (paths) buildPath(cur.e, *ws, &(*paths)[t->second]);
+      }
+      if (--remaining == 0) return;
+    }
+
+    const uint32_t n = g.getTo(cur.e);
+
+    for (uint32_t e = g.outBeg(n); e < g.outEnd(n); e++) {
+      if (ws->settled[e].gen == ws->gen) continue;
+
+      const uint32_t c = costF(g, cur.e, e);
+      if (c >= costF.inf()) continue;
+
+      const uint32_t newC = cur.d + c;
+      if (newC < cur.d || newC >= costF.inf()) continue;
+
+      ws->pq.push({static_cast<uint64_t>(newC) + heurF(g, e), newC, e, cur.e});
+    }
+  }
+}
+
+// _____________________________________________________________________________
+inline void CSRDijkstra::buildPath(uint32_t e, const Workspace& ws,
+                                   std::vector<uint32_t>* path) {
+  while (e != trgraph::CSRGraph::NO_ID) {
+    path->push_back(e);
+    e = ws.settled[e].pred;
+  }
+}
+
+// _____________________________________________________________________________
+inline CSRDijkstra::Workspace* CSRDijkstra::getWorkspace(
+    const trgraph::CSRGraph& g) {
+  static thread_local Workspace ws;
+
+  if (ws.settled.size() != g.getNumEdgs()) {
+    ws.settled.assign(g.getNumEdgs(), {0, trgraph::CSRGraph::NO_ID});
+    ws.gen = 0;
+  }
+
+  // on overflow, invalidate all labels explicitly
+  if (++ws.gen == 0) {
+    for (auto& l : ws.settled) l.gen = 0;
+    ws.gen = 1;
+  }
+
+  ws.pq.clear();
+  return &ws;
+}
+
+// _____________________________________________________________________________
+template <typename CF, typename HF>
+uint32_t CSRDijkstra::shortestPathBidir(const trgraph::CSRGraph& g,
+                                        uint32_t from, uint32_t to,
+                                        const CF& costF, const HF& heurTo,
+                                        const HF& heurFrom,
+                                        std::vector<uint32_t>* path) {
+  const uint32_t inf = costF.inf();
+  const uint32_t noId = trgraph::CSRGraph::NO_ID;
+
+  if (path) path->clear();
+
+  BiWorkspace* ws = getBiWorkspace(g);
+  IterCount iters;
+
+  // keys are twice the cost plus twice the potential, shifted by off to
+  // stay positive. The potential of the forward search is
+  // (heurTo - heurFrom) / 2, the one of the backward search its negation
+  const uint64_t off = static_cast<uint64_t>(1) << 33;
+  auto pot = [&](uint32_t e) {
+    return static_cast<int64_t>(heurTo(g, e)) -
+           static_cast<int64_t>(heurFrom(g, e));
+  };
+
+  ws->fwPq.push({off + pot(from), 0, from, noId});
+  ws->bwPq.push({off - pot(to), 0, to, noId});
+
+  // the cost of the best path found so far, and its meeting turn x -> y
+  uint64_t best = inf;
+  uint32_t x = noId, y = noId;
+
+  while (true) {
+    // if one search is exhausted, every path has been seen once the other
+    // one has settled its start edge
+    if (ws->fwPq.empty() && (ws->bwPq.empty() || ws->bw[to].gen == ws->gen))
+      break;
+    if (ws->bwPq.empty() && ws->fw[from].gen == ws->gen) break;
+
+    // the potentials cancel out on any path, so no unsettled edge can lie on
+    // a cheaper path once the sum of both minimum keys reaches 2 * best
+    if (!ws->fwPq.empty() && !ws->bwPq.empty() &&
+        ws->fwPq.top().prio + ws->bwPq.top().prio >= 2 * (best + off))
+      break;
+
+    const bool fw = ws->bwPq.empty() ||
+                    (!ws->fwPq.empty() &&
+                     ws->fwPq.top().prio <= ws->bwPq.top().prio);
+    QuadHeap& pq = fw ? ws->fwPq : ws->bwPq;
+    std::vector<BiLabel>& settled = fw ? ws->fw : ws->bw;
+    const std::vector<BiLabel>& other = fw ? ws->bw : ws->fw;
+
+    const PQEntry cur = pq.top();
+    pq.pop();
+
+    BiLabel& l = settled[cur.e];
+    if (l.gen == ws->gen) continue;
+    l = {ws->gen, cur.pred, cur.d};
+    iters.n++;
+
+    if (other[cur.e].gen == ws->gen &&
+        static_cast<uint64_t>(cur.d) + other[cur.e].d < best) {
+      best = static_cast<uint64_t>(cur.d) + other[cur.e].d;
+      x = y = cur.e;
+    }
+
+    if (fw) {
+      const uint32_t n = g.getTo(cur.e);
+      for (uint32_t e = g.outBeg(n); e < g.outEnd(n); e++) {
+        const uint32_t c = costF(g, cur.e, e);
+        if (c >= inf) continue;
+
+        const uint64_t newC = static_cast<uint64_t>(cur.d) + c;
+
+        if (ws->bw[e].gen == ws->gen && newC + ws->bw[e].d < best) {
+          best = newC + ws->bw[e].d;
+          x = cur.e;
+          y = e;
+        }
+
+        if (newC >= inf || ws->fw[e].gen == ws->gen) continue;
+        ws->fwPq.push({2 * newC + off + pot(e), static_cast<uint32_t>(newC),
+                       e, cur.e});
+      }
+    } else {
+      const uint32_t n = g.getFrom(cur.e);
+      for (uint32_t k = g.inBeg(n); k < g.inEnd(n); k++) {
+        const uint32_t e = g.getInEdg(k);
+        const uint32_t c = costF(g, e, cur.e);
+        if (c >= inf) continue;
+
+        const uint64_t newC = static_cast<uint64_t>(cur.d) + c;
+
+        if (ws->fw[e].gen == ws->gen && newC + ws->fw[e].d < best) {
+          best = newC + ws->fw[e].d;
+          x = e;
+          y = cur.e;
+        }
+
+        if (newC >= inf || ws->bw[e].gen == ws->gen) continue;
+        ws->bwPq.push({2 * newC + off - pot(e), static_cast<uint32_t>(newC),
+                       e, cur.e});
+      }
+    }
+  }
+
+  if (best >= inf) return inf;
+
+  if (path) {
+    // from to back to y, then from x to from, skipping x if the searches
+    // met in it
+    for (uint32_t e = y; e != noId; e = ws->bw[e].pred) path->push_back(e);
+    std::reverse(path->begin(), path->end());
+    for (uint32_t e = x == y ? ws->fw[x].pred : x; e != noId;
+         e = ws->fw[e].pred) {
+      path->push_back(e);
+    }
+  }
+
+  return best;
+}
+
+// _____________________________________________________________________________
+inline CSRDijkstra::BiWorkspace* CSRDijkstra::getBiWorkspace(
+    const trgraph::CSRGraph& g) {
+  static thread_local BiWorkspace ws;
+
+  if (ws.fw.size() != g.getNumEdgs()) {
+    ws.fw.assign(g.getNumEdgs(), {0, trgraph::CSRGraph::NO_ID, 0});
+    ws.bw.assign(g.getNumEdgs(), {0, trgraph::CSRGraph::NO_ID, 0});
+    ws.gen = 0;
+  }
+
+  // on overflow, invalidate all labels explicitly
+  if (++ws.gen == 0) {
+    for (auto& l : ws.fw) l.gen = 0;
+    for (auto& l : ws.bw) l.gen = 0;
+    ws.gen = 1;
+  }
+
+  ws.fwPq.clear();
+  ws.bwPq.clear();
+  return &ws;
+}
+
+// _____________________________________________________________________________
+inline void CSRDijkstra::QuadHeap::push(const PQEntry& v) {
+  size_t i = _h.size();
+  _h.push_back(v);
+
+  while (i > 0) {
+    const size_t par = (i - 1) / 4;
+    if (_h[par].prio <= v.prio) break;
+    _h[i] = _h[par];
+    i = par;
+  }
+
+  _h[i] = v;
+}
+
+// _____________________________________________________________________________
+inline void CSRDijkstra::QuadHeap::pop() {
+  const PQEntry v = _h.back();
+  _h.pop_back();
+  if (_h.empty()) return;
+
+  const size_t n = _h.size();
+  size_t i = 0;
+
+  while (true) {
+    const size_t first = 4 * i + 1;
+    if (first >= n) break;
+
+    size_t min = first;
+    const size_t last = std::min(first + 4, n);
+    for (size_t c = first + 1; c < last; c++) {
+      if (_h[c].prio < _h[min].prio) min = c;
+    }
+
+    if (v.prio <= _h[min].prio) break;
+    _h[i] = _h[min];
+    i = min;
+  }
+
+  _h[i] = v;
+}
+
+// _____________________________________________________________________________
+template <typename CF, typename HF>
+void CSRDijkstra::shortestPaths(const trgraph::CSRGraph& g,
+                                const std::vector<uint32_t>& froms,
+                                const std::vector<uint32_t>& tos,
+                                const CF& costF, const HF& heurTo,
+                                const HF& heurFrom,
+                                std::vector<uint32_t>* costs,
+                                std::vector<std::vector<uint32_t>>* paths) {
+  const size_t nf = froms.size();
+  const size_t nt = tos.size();
+  const uint32_t inf = costF.inf();
+
+  costs->assign(nf * nt, inf);
+  if (paths) paths->assign(nf * nt, {});
+
+  if (nf == 0 || nt == 0) return;
+
+  IterCount iters;
+
+  // searches [0, nf) run forward from froms, [nf, nf + nt) backward from tos
+  std::vector<SettledCost> settled(nf + nt);
+  std::vector<uint8_t> done(nf + nt, 0);
+  size_t numDone = 0;
+
+  // the meeting turn x -> y of the best path found for each pair so far
+  std::vector<std::pair<uint32_t, uint32_t>> meets(nf * nt);
+
+  // for each settled edge, the searches which settled it
+  std::unordered_map<uint32_t, std::vector<uint32_t>> fwBuckets, bwBuckets;
+
+  MPQ pq;
+  for (size_t i = 0; i < nf; i++)
+    pq.push({0, froms[i], trgraph::CSRGraph::NO_ID, static_cast<uint32_t>(i)});
+  for (size_t j = 0; j < nt; j++)
+    pq.push(
+        {0, tos[j], trgraph::CSRGraph::NO_ID, static_cast<uint32_t>(nf + j)});
+
+  while (!pq.empty() && numDone < nf + nt) {
+    const MPQEntry cur = pq.top();
+    pq.pop();
+
+    const uint32_t s = cur.search;
+    if (done[s]) continue;
+
+    // all edges below cur.d are settled in every search which is still
+    // running, so the best path of a pair is final once its cost is not
+    // above 2 * cur.d. If all pairs of a search are final, it can stop
+    const uint64_t radius = 2 * static_cast<uint64_t>(cur.d);
+    bool final = true;
+    if (s < nf) {
+      for (size_t j = 0; j < nt && final; j++)
+        final = (*costs)[s * nt + j] <= radius;
+    } else {
+      for (size_t i = 0; i < nf && final; i++)
+        final = (*costs)[i * nt + s - nf] <= radius;
+    }
+
+    if (final) {
+      done[s] = 1;
+      numDone++;
+      continue;
+    }
+
+    if (!settled[s].emplace(cur.e, std::make_pair(cur.d, cur.pred)).second)
+      continue;
+    iters.n++;
+
+    if (s < nf) {
+      const size_t i = s;
+      fwBuckets[cur.e].push_back(s);
+
+      auto b = bwBuckets.find(cur.e);
+      if (b != bwBuckets.end()) {
+        for (uint32_t t : b->second) {
+          meet(i, t - nf, nt, static_cast<uint64_t>(cur.d) +
+                                  settled[t].find(cur.e)->second.first,
+               cur.e, cur.e, costs, &meets);
+        }
+      }
+
+      const uint32_t n = g.getTo(cur.e);
+      for (uint32_t e = g.outBeg(n); e < g.outEnd(n); e++) {
+        const uint32_t c = costF(g, cur.e, e);
+        if (c >= inf) continue;
+
+        const uint64_t newC = static_cast<uint64_t>(cur.d) + c;
+
+        auto b = bwBuckets.find(e);
+        if (b != bwBuckets.end()) {
+          for (uint32_t t : b->second) {
+            meet(i, t - nf, nt, newC + settled[t].find(e)->second.first, cur.e,
+                 e, costs, &meets);
+          }
+        }
+
+        // no path to a target through e can be cheaper than inf
+        if (newC + heurTo(g, e) >= inf || settled[s].count(e)) continue;
+        pq.push({static_cast<uint32_t>(newC), e, cur.e, s});
+      }
+    } else {
+      const size_t j = s - nf;
+      bwBuckets[cur.e].push_back(s);
+
+      auto b = fwBuckets.find(cur.e);
+      if (b != fwBuckets.end()) {
+        for (uint32_t f : b->second) {
+          meet(f, j, nt, static_cast<uint64_t>(cur.d) +
+                             settled[f].find(cur.e)->second.first,
+               cur.e, cur.e, costs, &meets);
+        }
+      }
+
+      const uint32_t n = g.getFrom(cur.e);
+      for (uint32_t k = g.inBeg(n); k < g.inEnd(n); k++) {
+        const uint32_t e = g.getInEdg(k);
+        const uint32_t c = costF(g, e, cur.e);
+        if (c >= inf) continue;
+
+        const uint64_t newC = static_cast<uint64_t>(cur.d) + c;
+
+        auto b = fwBuckets.find(e);
+        if (b != fwBuckets.end()) {
+          for (uint32_t f : b->second) {
+            meet(f, j, nt, newC + settled[f].find(e)->second.first, e, cur.e,
+                 costs, &meets);
+          }
+        }
+
+        // no path from a source through e can be cheaper than inf
+        if (newC + heurFrom(g, e) >= inf || settled[s].count(e)) continue;
+        pq.push({static_cast<uint32_t>(newC), e, cur.e, s});
+      }
+    }
+  }
+
+  if (!paths) return;
+
+  for (size_t i = 0; i < nf; i++) {
+    for (size_t j = 0; j < nt; j++) {
+      if ((*costs)[i * nt + j] >= inf) continue;
+      buildPath(settled[i], settled[nf + j], meets[i * nt + j].first,
+                meets[i * nt + j].second, &(*paths)[i * nt + j]);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+inline void CSRDijkstra::meet(
+    size_t i, size_t j, size_t numTos, uint64_t c, uint32_t x, uint32_t y,
+    std::vector<uint32_t>* costs,
+    std::vector<std::pair<uint32_t, uint32_t>>* meets) {
+  if (c >= (*costs)[i * numTos + j]) return;
+  (*costs)[i * numTos + j] = c;
+  (*meets)[i * numTos + j] = {x, y};
+}
+
+// _____________________________________________________________________________
+inline void CSRDijkstra::buildPath(const SettledCost& fw, const SettledCost& bw,
+                                   uint32_t x, uint32_t y,
+                                   std::vector<uint32_t>* path) {
+  // from the target to y
+  std::vector<uint32_t> bwPath;
+  for (uint32_t e = y; e != trgraph::CSRGraph::NO_ID;
+       e = bw.find(e)->second.second) {
+    bwPath.push_back(e);
+  }
+
+  path->insert(path->end(), bwPath.rbegin(), bwPath.rend());
+
+  // from x to the source, skipping x if the searches met in x
+  uint32_t e = x == y ? fw.find(x)->second.second : x;
+  for (; e != trgraph::CSRGraph::NO_ID; e = fw.find(e)->second.second) {
+    path->push_back(e);
+  }
+}
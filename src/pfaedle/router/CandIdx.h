@@ -0,0 +1,122 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_ROUTER_CANDIDX_H_
+#define PFAEDLE_ROUTER_CANDIDX_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "pfaedle/Def.h"
+
+namespace pfaedle {
+namespace router {
+
+/*
+ * Static spatial index for the lookup of snapping candidates. Lines are
+ * split into their segments (points are stored as degenerate segments),
+ * which are bulk-loaded into a packed STR R-tree once all values have been
+ * added. Memory is linear in the number of segments and independent of the
+ * extent or density of the indexed area.
+ *
+ * Distances are planar, in the units of the coordinates.
+ */
+template <typename T>
+class CandIdx {
+ public:
+  CandIdx() {}
+
+  void add(const LINE& geom, T val);
+  void add(const POINT& geom, T val);
+
+  // Pack the added segments into the tree, must be called before get()
+  void build();
+
+  // Write each value with a segment within distance r of p to ret, together
+  // with its (minimal) distance to p, ordered by increasing distance. Does
+  // not modify the index and is safe to call concurrently. Returns the
+  // number of distance computations.
+  size_t get(const POINT& p, double r,
+             std::vector<std::pair<T, double>>* ret) const;
+
+  // Same as above for a batch of points, (*rets)[i] holds the values within
+  // rs[i] of ps[i]. The tree is traversed only once for the whole batch,
+  // which saves most of the work on the inner nodes if the points are close
+  // to each other.
+  size_t get(const std::vector<POINT>& ps, const std::vector<double>& rs,
+             std::vector<std::vector<std::pair<T, double>>>* rets) const;
+
+  size_t size() const;
+  size_t getMemSize() const;
+
+ private:
+  // the number of entries per tree node
+  static const size_t CAP = 16;
+
+  struct Seg {
+    double ax, ay, bx, by;
+    uint32_t val;
+  };
+
+  struct Nd {
+    double lx, ly, ux, uy;
+    // children range, into _segs on the lowest level, into _nds otherwise
+    uint32_t beg, end;
+  };
+
+  struct PQEntry {
+    double d;
+    uint32_t id;
+    bool seg;
+    bool operator<(const PQEntry& o) const { return d > o.d; }
+  };
+
+  std::vector<T> _vals;
+  std::vector<Seg> _segs;
+  std::vector<Nd> _nds;
+
+  // the number of nodes on the lowest level, which come first in _nds
+  size_t _numLeafs = 0;
+
+  static double segDist(const Seg& s, double x, double y);
+  static double boxDist(const Nd& n, double x, double y);
+  static bool intersects(const Nd& a, const Nd& b);
+
+  static Nd getBox(const Seg& s);
+  static Nd getBox(const Nd& n);
+
+  // sort the items into STR order, and return the node boxes of groups of
+  // CAP consecutive items
+  template <typename I>
+  static std::vector<Nd> pack(std::vector<I>* items, size_t off);
+};
+
+// Position of cell (x, y) on a Hilbert curve through a 2^16 x 2^16 grid
+inline uint64_t hilbertIdx(uint32_t x, uint32_t y) {
+  uint64_t d = 0;
+  for (uint32_t s = 1 << 15; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    // rotate the quadrant
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+#include "pfaedle/router/CandIdx.tpp"
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_CANDIDX_H_
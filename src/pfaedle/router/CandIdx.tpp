@@ -0,0 +1,281 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+// _____________________________________________________________________________
+template <typename T>
+void CandIdx<T>::add(const LINE& geom, T val) {
+  if (geom.empty()) return;
+  uint32_t id = _vals.size();
+  _vals.push_back(val);
+
+  if (geom.size() == 1) {
+    _segs.push_back({geom[0].getX(), geom[0].getY(), geom[0].getX(),
+                     geom[0].getY(), id});
+    return;
+  }
+
+  for (size_t i = 1; i < geom.size(); i++) {
+    _segs.push_back({geom[i - 1].getX(), geom[i - 1].getY(), geom[i].getX(),
+                     geom[i].getY(), id});
+  }
+}
+
+// _____________________________________________________________________________
+template <typename T>
+void CandIdx<T>::add(const POINT& geom, T val) {
+  uint32_t id = _vals.size();
+  _vals.push_back(val);
+  _segs.push_back({geom.getX(), geom.getY(), geom.getX(), geom.getY(), id});
+}
+
+// _____________________________________________________________________________
+template <typename T>
+void CandIdx<T>::build() {
+  _nds.clear();
+  _numLeafs = 0;
+  _vals.shrink_to_fit();
+  _segs.shrink_to_fit();
+
+  if (_segs.empty()) return;
+
+  _nds = pack(&_segs, 0);
+  _numLeafs = _nds.size();
+
+  // pack each level into the next one until a single root is left, the
+  // children of a node are a contiguous range of the level below
+  size_t lvlBeg = 0;
+  while (_nds.size() - lvlBeg > 1) {
+    std::vector<Nd> lvl(_nds.begin() + lvlBeg, _nds.end());
+    auto up = pack(&lvl, lvlBeg);
+    std::copy(lvl.begin(), lvl.end(), _nds.begin() + lvlBeg);
+    lvlBeg = _nds.size();
+    _nds.insert(_nds.end(), up.begin(), up.end());
+  }
+
+  _nds.shrink_to_fit();
+}
+
+// _____________________________________________________________________________
+template <typename T>
+template <typename I>
+std::vector<typename CandIdx<T>::Nd> CandIdx<T>::pack(std::vector<I>* items,
+                                                      size_t off) {
+  size_t n = items->size();
+  size_t numNds = (n + CAP - 1) / CAP;
+  size_t numSlices = std::ceil(std::sqrt(numNds));
+  size_t sliceSize = numSlices * CAP;
+
+  // sort-tile-recursive: sort by x, cut into vertical slices, sort each
+  // slice by y
+  std::sort(items->begin(), items->end(), [](const I& a, const I& b) {
+    Nd ba = getBox(a), bb = getBox(b);
+    return ba.lx + ba.ux < bb.lx + bb.ux;
+  });
+
+  for (size_t i = 0; i < n; i += sliceSize) {
+    std::sort(items->begin() + i, items->begin() + std::min(i + sliceSize, n),
+              [](const I& a, const I& b) {
+                Nd ba = getBox(a), bb = getBox(b);
+                return ba.ly + ba.uy < bb.ly + bb.uy;
+              });
+  }
+
+  std::vector<Nd> ret;
+  ret.reserve(numNds);
+
+  for (size_t i = 0; i < n; i += CAP) {
+    size_t end = std::min(i + CAP, n);
+    Nd nd = getBox((*items)[i]);
+    for (size_t j = i + 1; j < end; j++) {
+      Nd b = getBox((*items)[j]);
+      nd.lx = std::min(nd.lx, b.lx);
+      nd.ly = std::min(nd.ly, b.ly);
+      nd.ux = std::max(nd.ux, b.ux);
+      nd.uy = std::max(nd.uy, b.uy);
+    }
+    nd.beg = off + i;
+    nd.end = off + end;
+    ret.push_back(nd);
+  }
+
+  return ret;
+}
+
+// _____________________________________________________________________________
+template <typename T>
+size_t CandIdx<T>::get(const POINT& p, double r,
+                       std::vector<std::pair<T, double>>* ret) const {
+  if (_nds.empty()) return 0;
+
+  double x = p.getX(), y = p.getY();
+
+  // best-first search, entries are popped in order of increasing distance,
+  // so the first segment of a value that is popped is its nearest one
+  std::priority_queue<PQEntry> pq;
+  std::unordered_set<uint32_t> found;
+
+  uint32_t root = _nds.size() - 1;
+  double d = boxDist(_nds[root], x, y);
+  size_t numDists = 1;
+  if (d <= r) pq.push({d, root, false});
+
+  while (!pq.empty()) {
+    auto cur = pq.top();
+    pq.pop();
+
+    if (cur.seg) {
+      uint32_t val = _segs[cur.id].val;
+      if (found.insert(val).second) ret->push_back({_vals[val], cur.d});
+      continue;
+    }
+
+    const Nd& nd = _nds[cur.id];
+    bool leaf = cur.id < _numLeafs;
+
+    for (uint32_t i = nd.beg; i < nd.end; i++) {
+      double cd = leaf ? segDist(_segs[i], x, y) : boxDist(_nds[i], x, y);
+      if (cd <= r) pq.push({cd, i, leaf});
+    }
+    numDists += nd.end - nd.beg;
+  }
+
+  return numDists;
+}
+
+// _____________________________________________________________________________
+template <typename T>
+size_t CandIdx<T>::get(
+    const std::vector<POINT>& ps, const std::vector<double>& rs,
+    std::vector<std::vector<std::pair<T, double>>>* rets) const {
+  rets->resize(ps.size());
+  for (auto& ret : *rets) ret.clear();
+  if (_nds.empty() || ps.empty()) return 0;
+
+  // the query boxes of the single points, and the box of the whole batch
+  std::vector<Nd> qs(ps.size());
+  Nd batch = {std::numeric_limits<double>::max(),
+              std::numeric_limits<double>::max(),
+              std::numeric_limits<double>::lowest(),
+              std::numeric_limits<double>::lowest(), 0, 0};
+
+  for (size_t i = 0; i < ps.size(); i++) {
+    qs[i] = {ps[i].getX() - rs[i], ps[i].getY() - rs[i], ps[i].getX() + rs[i],
+             ps[i].getY() + rs[i], 0, 0};
+    batch.lx = std::min(batch.lx, qs[i].lx);
+    batch.ly = std::min(batch.ly, qs[i].ly);
+    batch.ux = std::max(batch.ux, qs[i].ux);
+    batch.uy = std::max(batch.uy, qs[i].uy);
+  }
+
+  // (value, distance) hits per point, may contain a value more than once
+  std::vector<std::vector<std::pair<uint32_t, double>>> hits(ps.size());
+
+  size_t numDists = 0;
+  std::vector<uint32_t> stack = {static_cast<uint32_t>(_nds.size() - 1)};
+
+  while (!stack.empty()) {
+    uint32_t cur = stack.back();
+    stack.pop_back();
+
+    const Nd& nd = _nds[cur];
+    numDists++;
+    if (!intersects(nd, batch)) continue;
+
+    if (cur >= _numLeafs) {
+      for (uint32_t i = nd.beg; i < nd.end; i++) stack.push_back(i);
+      continue;
+    }
+
+    for (uint32_t i = nd.beg; i < nd.end; i++) {
+      const Seg& seg = _segs[i];
+      Nd box = getBox(seg);
+      if (!intersects(box, batch)) continue;
+
+      for (size_t j = 0; j < ps.size(); j++) {
+        if (!intersects(box, qs[j])) continue;
+        double d = segDist(seg, ps[j].getX(), ps[j].getY());
+        numDists++;
+        if (d <= rs[j]) hits[j].push_back({seg.val, d});
+      }
+    }
+  }
+
+  for (size_t j = 0; j < ps.size(); j++) {
+    auto& h = hits[j];
+
+    // keep the nearest hit of each value
+    std::sort(h.begin(), h.end());
+    h.erase(std::unique(h.begin(), h.end(),
+                        [](const std::pair<uint32_t, double>& a,
+                           const std::pair<uint32_t, double>& b) {
+                          return a.first == b.first;
+                        }),
+            h.end());
+    std::stable_sort(h.begin(), h.end(),
+                     [](const std::pair<uint32_t, double>& a,
+                        const std::pair<uint32_t, double>& b) {
+                       return a.second < b.second;
+                     });
+
+    (*rets)[j].reserve(h.size());
+    for (const auto& hit : h) {
+      (*rets)[j].push_back({_vals[hit.first], hit.second});
+    }
+  }
+
+  return numDists;
+}
+
+// _____________________________________________________________________________
+template <typename T>
+double CandIdx<T>::segDist(const Seg& s, double x, double y) {
+  double dx = s.bx - s.ax, dy = s.by - s.ay;
+  double l = dx * dx + dy * dy;
+  double t = 0;
+  if (l > 0) {
+    t = ((x - s.ax) * dx + (y - s.ay) * dy) / l;
+    t = std::max(0.0, std::min(1.0, t));
+  }
+  double px = s.ax + t * dx - x, py = s.ay + t * dy - y;
+  return std::sqrt(px * px + py * py);
+}
+
+// _____________________________________________________________________________
+template <typename T>
+double CandIdx<T>::boxDist(const Nd& n, double x, double y) {
+  double dx = std::max(0.0, std::max(n.lx - x, x - n.ux));
+  double dy = std::max(0.0, std::max(n.ly - y, y - n.uy));
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+// _____________________________________________________________________________
+template <typename T>
+bool CandIdx<T>::intersects(const Nd& a, const Nd& b) {
+  return a.lx <= b.ux && b.lx <= a.ux && a.ly <= b.uy && b.ly <= a.uy;
+}
+
+// _____________________________________________________________________________
+template <typename T>
+typename CandIdx<T>::Nd CandIdx<T>::getBox(const Seg& s) {
+  return {std::min(s.ax, s.bx), std::min(s.ay, s.by), std::max(s.ax, s.bx),
+          std::max(s.ay, s.by), 0, 0};
+}
+
+// _____________________________________________________________________________
+template <typename T>
+typename CandIdx<T>::Nd CandIdx<T>::getBox(const Nd& n) {
+  return n;
+}
+
+// _____________________________________________________________________________
+template <typename T>
+size_t CandIdx<T>::size() const {
+  return _vals.size();
+}
+
+// _____________________________________________________________________________
+template <typename T>
+size_t CandIdx<T>::getMemSize() const {
+  return _vals.capacity() * sizeof(T) + _segs.capacity() * sizeof(Seg) +
+         _nds.capacity() * sizeof(Nd);
+}
@@ -0,0 +1,409 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "pfaedle/router/ContractionHierarchy.h"
+#include "pfaedle/router/RoutingAttrs.h"
+#include "pfaedle/router/Weights.h"
+#include "util/log/Log.h"
+
+using pfaedle::router::ContractionHierarchy;
+using pfaedle::router::ExpoTransWeight;
+using pfaedle::router::RoutingAttrs;
+using pfaedle::router::RoutingOpts;
+
+const uint32_t ContractionHierarchy::INF;
+const uint32_t ContractionHierarchy::NO_MID;
+std::atomic<size_t> ContractionHierarchy::ITERS(0);
+
+// _____________________________________________________________________________
+ContractionHierarchy::ContractionHierarchy(const trgraph::CSRGraph& g,
+                                           const RoutingOpts& rOpts,
+                                           const osm::Restrictor& res)
+    : _g(g), _rOpts(rOpts), _res(res), _numShortcuts(0) {
+  const uint32_t n = _g.getNumEdgs();
+
+  // without any routing attributes, the cost function yields the base costs
+  RoutingAttrs noAttrs;
+  ExpoTransWeight::CostFunc baseCost(noAttrs, _rOpts, _res, INF);
+
+  std::vector<std::vector<Arc>> out(n), in(n);
+
+  for (uint32_t e = 0; e < n; e++) {
+    const uint32_t nd = _g.getTo(e);
+    for (uint32_t f = _g.outBeg(nd); f < _g.outEnd(nd); f++) {
+      if (f == e) continue;
+      const uint32_t w = baseCost(_g, e, f);
+      if (w >= INF) continue;
+      out[e].push_back({f, w, NO_MID});
+      in[f].push_back({e, w, NO_MID});
+    }
+  }
+
+  contract(&out, &in);
+
+  // split the arcs into the upward and the downward graph
+  _upOffs.assign(n + 1, 0);
+  _downOffs.assign(n + 1, 0);
+
+  for (uint32_t u = 0; u < n; u++) {
+    for (const Arc& a : out[u]) {
+      if (_rank[u] < _rank[a.to])
+        _upOffs[u + 1]++;
+      else
+        _downOffs[a.to + 1]++;
+    }
+  }
+
+  for (uint32_t u = 0; u < n; u++) {
+    _upOffs[u + 1] += _upOffs[u];
+    _downOffs[u + 1] += _downOffs[u];
+  }
+
+  _up.resize(_upOffs[n]);
+  _down.resize(_downOffs[n]);
+
+  std::vector<uint32_t> upPos(_upOffs.begin(), _upOffs.end() - 1);
+  std::vector<uint32_t> downPos(_downOffs.begin(), _downOffs.end() - 1);
+
+  for (uint32_t u = 0; u < n; u++) {
+    for (const Arc& a : out[u]) {
+      if (_rank[u] < _rank[a.to])
+        _up[upPos[u]++] = a;
+      else
+        _down[downPos[a.to]++] = {u, a.w, a.mid};
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::contract(std::vector<std::vector<Arc>>* out,
+                                    std::vector<std::vector<Arc>>* in) {
+  const uint32_t n = _g.getNumEdgs();
+
+  std::vector<uint8_t> contracted(n, 0);
+  std::vector<uint32_t> delNeighbors(n, 0);
+  std::vector<uint32_t> dist(n, INF);
+  std::vector<uint32_t> touched;
+
+  _rank.assign(n, 0);
+
+  typedef std::pair<int64_t, uint32_t> QEntry;
+  std::priority_queue<QEntry, std::vector<QEntry>, std::greater<QEntry>> pq;
+
+  for (uint32_t v = 0; v < n; v++) {
+    pq.push({getPrio(v, out, in, contracted, delNeighbors, &dist, &touched),
+             v});
+  }
+
+  uint32_t rank = 0;
+
+  while (!pq.empty()) {
+    const uint32_t v = pq.top().second;
+    pq.pop();
+
+    // lazy update: if the priority got worse, contract v later
+    int64_t prio = getPrio(v, out, in, contracted, delNeighbors, &dist,
+                           &touched);
+    if (!pq.empty() && prio > pq.top().first) {
+      pq.push({prio, v});
+      continue;
+    }
+
+    _numShortcuts +=
+        contractNd(v, false, out, in, contracted, &dist, &touched);
+    contracted[v] = 1;
+    _rank[v] = rank++;
+
+    for (const Arc& a : (*in)[v]) delNeighbors[a.to]++;
+    for (const Arc& a : (*out)[v]) delNeighbors[a.to]++;
+  }
+
+  LOG(DEBUG) << "Contracted " << n << " edges, added " << _numShortcuts
+             << " shortcuts";
+}
+
+// _____________________________________________________________________________
+int64_t ContractionHierarchy::getPrio(
+    uint32_t v, std::vector<std::vector<Arc>>* out,
+    std::vector<std::vector<Arc>>* in, const std::vector<uint8_t>& contracted,
+    const std::vector<uint32_t>& delNeighbors, std::vector<uint32_t>* dist,
+    std::vector<uint32_t>* touched) const {
+  int64_t deg = 0;
+  for (const Arc& a : (*in)[v]) deg += !contracted[a.to];
+  for (const Arc& a : (*out)[v]) deg += !contracted[a.to];
+
+  const int64_t shortcuts =
+      contractNd(v, true, out, in, contracted, dist, touched);
+
+  // edge difference plus the number of already contracted neighbors, to
+  // spread the contraction uniformly over the graph
+  return shortcuts - deg + delNeighbors[v];
+}
+
+// _____________________________________________________________________________
+size_t ContractionHierarchy::contractNd(uint32_t v, bool simulate,
+                                        std::vector<std::vector<Arc>>* out,
+                                        std::vector<std::vector<Arc>>* in,
+                                        const std::vector<uint8_t>& contracted,
+                                        std::vector<uint32_t>* dist,
+                                        std::vector<uint32_t>* touched) const {
+  size_t ret = 0;
+  const size_t limit = simulate ? SIM_SETTLE_LIMIT : CONTR_SETTLE_LIMIT;
+
+  // shortcuts never start or end at v, so the arc lists of v are stable
+  for (const Arc& inA : (*in)[v]) {
+    const uint32_t u = inA.to;
+    if (contracted[u] || u == v) continue;
+
+    bool cands = false;
+    uint32_t maxW = 0;
+    for (const Arc& outA : (*out)[v]) {
+      if (contracted[outA.to] || outA.to == u || outA.to == v) continue;
+      const uint64_t w = static_cast<uint64_t>(inA.w) + outA.w;
+      if (w >= INF) continue;
+      cands = true;
+      if (w > maxW) maxW = w;
+    }
+
+    if (!cands) continue;
+
+    witnessSearch(u, v, maxW, limit, *out, contracted, dist, touched);
+
+    for (const Arc& outA : (*out)[v]) {
+      if (contracted[outA.to] || outA.to == u || outA.to == v) continue;
+      const uint64_t w = static_cast<uint64_t>(inA.w) + outA.w;
+      if (w >= INF || (*dist)[outA.to] <= w) continue;
+
+      ret++;
+      if (!simulate) addArc(out, in, u, outA.to, w, v);
+    }
+
+    for (uint32_t t : *touched) (*dist)[t] = INF;
+    touched->clear();
+  }
+
+  return ret;
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::witnessSearch(
+    uint32_t from, uint32_t skip, uint32_t maxW, size_t maxSettled,
+    const std::vector<std::vector<Arc>>& out,
+    const std::vector<uint8_t>& contracted, std::vector<uint32_t>* dist,
+    std::vector<uint32_t>* touched) const {
+  typedef std::pair<uint32_t, uint32_t> QEntry;
+  std::priority_queue<QEntry, std::vector<QEntry>, std::greater<QEntry>> pq;
+
+  (*dist)[from] = 0;
+  touched->push_back(from);
+  pq.push({0, from});
+
+  size_t settled = 0;
+
+  while (!pq.empty()) {
+    const QEntry cur = pq.top();
+    pq.pop();
+
+    if (cur.first > (*dist)[cur.second]) continue;
+    if (cur.first > maxW || ++settled > maxSettled) break;
+
+    for (const Arc& a : out[cur.second]) {
+      if (contracted[a.to] || a.to == skip) continue;
+      const uint64_t d = static_cast<uint64_t>(cur.first) + a.w;
+      if (d > maxW || d >= (*dist)[a.to]) continue;
+      if ((*dist)[a.to] == INF) touched->push_back(a.to);
+      (*dist)[a.to] = d;
+      pq.push({d, a.to});
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::addArc(std::vector<std::vector<Arc>>* out,
+                                  std::vector<std::vector<Arc>>* in,
+                                  uint32_t from, uint32_t to, uint32_t w,
+                                  uint32_t mid) {
+  for (Arc& a : (*out)[from]) {
+    if (a.to != to) continue;
+    if (w >= a.w) return;
+
+    // replace the existing arc
+    a.w = w;
+    a.mid = mid;
+    for (Arc& b : (*in)[to]) {
+      if (b.to != from) continue;
+      b.w = w;
+      b.mid = mid;
+    }
+    return;
+  }
+
+  (*out)[from].push_back({to, w, mid});
+  (*in)[to].push_back({from, w, mid});
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::shortestPaths(
+    const std::vector<uint32_t>& froms, const std::vector<uint32_t>& tos,
+    uint32_t maxCost, std::vector<uint32_t>* costs,
+    std::vector<std::vector<uint32_t>>* paths) const {
+  costs->assign(froms.size() * tos.size(), maxCost);
+  if (paths) paths->assign(froms.size() * tos.size(), {});
+
+  if (froms.empty() || tos.empty()) return;
+
+  // backward searches from all targets, remember for each settled node
+  // which targets it reaches at which cost
+  std::vector<SearchSpace> bw(tos.size());
+  std::unordered_map<uint32_t, std::vector<std::pair<size_t, uint32_t>>>
+      buckets;
+
+  for (size_t j = 0; j < tos.size(); j++) {
+    upSearch(tos[j], maxCost, _downOffs, _down, &bw[j]);
+    for (const auto& s : bw[j]) buckets[s.first].push_back({j, s.second.d});
+  }
+
+  std::vector<uint32_t> meet(tos.size());
+
+  for (size_t i = 0; i < froms.size(); i++) {
+    SearchSpace fw;
+    upSearch(froms[i], maxCost, _upOffs, _up, &fw);
+
+    meet.assign(tos.size(), INF);
+
+    for (const auto& s : fw) {
+      auto b = buckets.find(s.first);
+      if (b == buckets.end()) continue;
+      for (const auto& t : b->second) {
+        const uint64_t c = static_cast<uint64_t>(s.second.d) + t.second;
+        uint32_t* cur = &(*costs)[i * tos.size() + t.first];
+        if (c < *cur) {
+          *cur = c;
+          meet[t.first] = s.first;
+        }
+      }
+    }
+
+    if (!paths) continue;
+
+    for (size_t j = 0; j < tos.size(); j++) {
+      if (meet[j] == INF) continue;
+      buildPath(fw, bw[j], meet[j], &(*paths)[i * tos.size() + j]);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::upSearch(uint32_t from, uint32_t maxCost,
+                                    const std::vector<uint32_t>& offs,
+                                    const std::vector<Arc>& arcs,
+                                    SearchSpace* space) const {
+  typedef std::pair<uint32_t, uint32_t> QEntry;
+  std::priority_queue<QEntry, std::vector<QEntry>, std::greater<QEntry>> pq;
+  SearchSpace tentative;
+
+  tentative[from] = {0, NO_MID, NO_MID};
+  pq.push({0, from});
+
+  while (!pq.empty()) {
+    const QEntry cur = pq.top();
+    pq.pop();
+
+    const auto& st = tentative.find(cur.second)->second;
+    if (cur.first > st.d || space->count(cur.second)) continue;
+
+    (*space)[cur.second] = st;
+
+    for (uint32_t k = offs[cur.second]; k < offs[cur.second + 1]; k++) {
+      const Arc& a = arcs[k];
+      const uint64_t d = static_cast<uint64_t>(cur.first) + a.w;
+      if (d >= maxCost) continue;
+
+      auto t = tentative.find(a.to);
+      if (t != tentative.end() && t->second.d <= d) continue;
+
+      tentative[a.to] = {static_cast<uint32_t>(d), cur.second, k};
+      pq.push({d, a.to});
+    }
+  }
+
+  ITERS += space->size();
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::buildPath(const SearchSpace& fw,
+                                     const SearchSpace& bw, uint32_t meet,
+                                     std::vector<uint32_t>* path) const {
+  // arcs of the forward search, from the meeting node back to the source
+  std::vector<std::pair<uint32_t, uint32_t>> fwArcs;
+  for (uint32_t v = meet; fw.find(v)->second.pred != NO_MID;) {
+    const auto& st = fw.find(v)->second;
+    fwArcs.push_back({st.pred, st.arc});
+    v = st.pred;
+  }
+
+  uint32_t cur = meet;
+  if (!fwArcs.empty()) cur = fwArcs.back().first;
+  path->push_back(cur);
+
+  for (auto i = fwArcs.rbegin(); i != fwArcs.rend(); i++) {
+    unpack(i->first, _up[i->second].to, _up[i->second].mid, path);
+  }
+
+  // arcs of the backward search, from the meeting node to the target
+  for (uint32_t u = meet; bw.find(u)->second.pred != NO_MID;) {
+    const auto& st = bw.find(u)->second;
+    unpack(u, st.pred, _down[st.arc].mid, path);
+    u = st.pred;
+  }
+
+  // same order as in CSRDijkstra, starting with the target
+  std::reverse(path->begin(), path->end());
+}
+
+// _____________________________________________________________________________
+void ContractionHierarchy::unpack(uint32_t from, uint32_t to, uint32_t mid,
+                                  std::vector<uint32_t>* path) const {
+  if (mid == NO_MID) {
+    path->push_back(to);
+    return;
+  }
+
+  // mid was contracted before from and to, so from -> mid is a downward
+  // arc of mid and mid -> to is an upward arc of mid
+  uint32_t fromMid = NO_MID, toMid = NO_MID;
+
+  for (uint32_t k = _downOffs[mid]; k < _downOffs[mid + 1]; k++) {
+    if (_down[k].to == from) {
+      fromMid = _down[k].mid;
+      break;
+    }
+  }
+
+  for (uint32_t k = _upOffs[mid]; k < _upOffs[mid + 1]; k++) {
+    if (_up[k].to == to) {
+      toMid = _up[k].mid;
+      break;
+    }
+  }
+
+  unpack(from, mid, fromMid, path);
+  unpack(mid, to, toMid, path);
+}
+
+// _____________________________________________________________________________
+bool ContractionHierarchy::isLowerBound(const RoutingOpts& rOpts,
+                                        const osm::Restrictor& res) const {
+  // line similarity penalties only ever make the base costs more expensive
+  // if all punish factors are >= 1
+  return &res == &_res && rOpts == _rOpts &&
+         rOpts.lineUnmatchedPunishFact >= 1 &&
+         rOpts.lineNameFromUnmatchedPunishFact >= 1 &&
+         rOpts.lineNameToUnmatchedPunishFact >= 1;
+}
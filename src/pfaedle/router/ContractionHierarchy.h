@@ -0,0 +1,131 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_ROUTER_CONTRACTIONHIERARCHY_H_
+#define PFAEDLE_ROUTER_CONTRACTIONHIERARCHY_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/Misc.h"
+#include "pfaedle/trgraph/CSRGraph.h"
+
+namespace pfaedle {
+namespace router {
+
+/*
+ * Contraction hierarchy over the turns of a CSR transit graph. The nodes of
+ * the hierarchy are the graph edges, an arc e -> f exists for every turn
+ * from e onto f and is weighted with the attribute-independent base cost of
+ * that turn: the cost of e plus the full turn and turn restriction
+ * penalties. Line similarity penalties are not included, so for punish
+ * factors >= 1 the costs found here are lower bounds of the real costs.
+ */
+class ContractionHierarchy {
+ public:
+  ContractionHierarchy(const trgraph::CSRGraph& g, const RoutingOpts& rOpts,
+                       const osm::Restrictor& res);
+
+  // Calculate the base costs from each edge in froms to each edge in tos.
+  // The cost from froms[i] to tos[j] is written to (*costs)[i * |tos| + j],
+  // maxCost if it is not below maxCost. If paths is not null, the path is
+  // written to the same position in paths, with the same conventions as in
+  // CSRDijkstra::shortestPath
+  void shortestPaths(const std::vector<uint32_t>& froms,
+                     const std::vector<uint32_t>& tos, uint32_t maxCost,
+                     std::vector<uint32_t>* costs,
+                     std::vector<std::vector<uint32_t>>* paths) const;
+
+  // Check if the hierarchy was built for rOpts and res, and if its costs
+  // are lower bounds of the costs under rOpts
+  bool isLowerBound(const RoutingOpts& rOpts,
+                    const osm::Restrictor& res) const;
+
+  size_t getNumShortcuts() const { return _numShortcuts; }
+
+  // Number of nodes settled by all query searches so far
+  static std::atomic<size_t> ITERS;
+
+ private:
+  struct Arc {
+    uint32_t to;
+    uint32_t w;
+    uint32_t mid;
+  };
+
+  struct Settled {
+    uint32_t d;
+    uint32_t pred;
+    uint32_t arc;
+  };
+
+  typedef std::unordered_map<uint32_t, Settled> SearchSpace;
+
+  const trgraph::CSRGraph& _g;
+  const RoutingOpts _rOpts;
+  const osm::Restrictor& _res;
+
+  std::vector<uint32_t> _rank;
+
+  // arcs u -> v with rank(u) < rank(v), grouped by u
+  std::vector<uint32_t> _upOffs;
+  std::vector<Arc> _up;
+
+  // arcs u -> v with rank(u) > rank(v), grouped by v, "to" is u
+  std::vector<uint32_t> _downOffs;
+  std::vector<Arc> _down;
+
+  size_t _numShortcuts;
+
+  void contract(std::vector<std::vector<Arc>>* out,
+                std::vector<std::vector<Arc>>* in);
+
+  int64_t getPrio(uint32_t v, std::vector<std::vector<Arc>>* out,
+                  std::vector<std::vector<Arc>>* in,
+                  const std::vector<uint8_t>& contracted,
+                  const std::vector<uint32_t>& delNeighbors,
+                  std::vector<uint32_t>* dist,
+                  std::vector<uint32_t>* touched) const;
+
+  size_t contractNd(uint32_t v, bool simulate,
+                    std::vector<std::vector<Arc>>* out,
+                    std::vector<std::vector<Arc>>* in,
+                    const std::vector<uint8_t>& contracted,
+                    std::vector<uint32_t>* dist,
+                    std::vector<uint32_t>* touched) const;
+
+  void witnessSearch(uint32_t from, uint32_t skip, uint32_t maxW,
+                     size_t maxSettled,
+                     const std::vector<std::vector<Arc>>& out,
+                     const std::vector<uint8_t>& contracted,
+                     std::vector<uint32_t>* dist,
+                     std::vector<uint32_t>* touched) const;
+
+  static void addArc(std::vector<std::vector<Arc>>* out,
+                     std::vector<std::vector<Arc>>* in, uint32_t from,
+                     uint32_t to, uint32_t w, uint32_t mid);
+
+  void upSearch(uint32_t from, uint32_t maxCost,
+                const std::vector<uint32_t>& offs,
+                const std::vector<Arc>& arcs, SearchSpace* space) const;
+
+  void buildPath(const SearchSpace& fw, const SearchSpace& bw, uint32_t meet,
+                 std::vector<uint32_t>* path) const;
+
+  // append the edges of the (possibly shortcut) arc from -> to to path
+  void unpack(uint32_t from, uint32_t to, uint32_t mid,
+              std::vector<uint32_t>* path) const;
+
+  static const uint32_t INF = std::numeric_limits<uint32_t>::max();
+  static const uint32_t NO_MID = std::numeric_limits<uint32_t>::max();
+
+  static const size_t SIM_SETTLE_LIMIT = 50;
+  static const size_t CONTR_SETTLE_LIMIT = 500;
+};
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_CONTRACTIONHIERARCHY_H_
@@ -2,8 +2,10 @@
 // Chair of Algorithms and Data Structures.
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
-#include <utility>
+#include <stdint.h>
+#include <mutex>
 #include <set>
+#include <utility>
 #include "pfaedle/router/HopCache.h"
 #include "pfaedle/trgraph/Graph.h"
 #include "util/Misc.h"
@@ -11,30 +13,80 @@
 using pfaedle::router::HopCache;
 using pfaedle::trgraph::Edge;
 
+const size_t HopCache::NUM_SHARDS;
+
+// _____________________________________________________________________________
+HopCache::HopCache() : _shared(0), _lookups(0), _hits(0), _contended(0) {}
+
+// _____________________________________________________________________________
+HopCache::HopCache(HopCache* shared)
+    : _shared(shared), _lookups(0), _hits(0), _contended(0) {}
+
 // _____________________________________________________________________________
 void HopCache::setMin(const Edge* a, const Edge* b, uint32_t val) {
-  _cache.set(a, b, val);
+  set(a, b, val);
 }
 
 // _____________________________________________________________________________
 void HopCache::setEx(const Edge* a, const Edge* b, uint32_t val) {
   int64_t v = val;
-  _cache.set(a, b, -(v + 1));
+  set(a, b, -(v + 1));
 }
 
 // _____________________________________________________________________________
 void HopCache::setMin(const Edge* a, const std::set<Edge*>& b, uint32_t val) {
-  for (auto eb : b) _cache.set(a, eb, val);
+  for (auto eb : b) set(a, eb, val);
 }
 
 // _____________________________________________________________________________
 void HopCache::setMin(const std::set<Edge*>& a, const Edge* b, uint32_t val) {
-  for (auto ea : a) _cache.set(ea, b, val);
+  for (auto ea : a) set(ea, b, val);
 }
 
 // _____________________________________________________________________________
 std::pair<uint32_t, bool> HopCache::get(const Edge* a, const Edge* b) const {
-  int64_t v = _cache.get(a, b);
+  Shard& s = getShard(a, b);
+  int64_t v;
+  {
+    auto l = lock(&s);
+    v = s.cache.get(a, b);
+  }
+
+  // lower bounds are no answers to the lookup, only count exact costs
+  _lookups++;
+  if (v < 0) _hits++;
+
   if (v < 0) return {(-v) - 1, 1};
   return {v, 0};
 }
+
+// _____________________________________________________________________________
+HopCache* HopCache::getShared() {
+  if (_shared) return _shared;
+  return this;
+}
+
+// _____________________________________________________________________________
+void HopCache::set(const Edge* a, const Edge* b, int64_t val) {
+  Shard& s = getShard(a, b);
+  auto l = lock(&s);
+  s.cache.set(a, b, val);
+}
+
+// _____________________________________________________________________________
+HopCache::Shard& HopCache::getShard(const Edge* a, const Edge* b) const {
+  // edges are heap allocated, the lowest bits carry no information
+  const size_t h = (reinterpret_cast<uintptr_t>(a) >> 4) * 31 +
+                   (reinterpret_cast<uintptr_t>(b) >> 4);
+  return _shards[h % NUM_SHARDS];
+}
+
+// _____________________________________________________________________________
+std::unique_lock<std::mutex> HopCache::lock(Shard* s) const {
+  std::unique_lock<std::mutex> l(s->m, std::try_to_lock);
+  if (!l.owns_lock()) {
+    _contended++;
+    l.lock();
+  }
+  return l;
+}
@@ -5,7 +5,9 @@
 #ifndef PFAEDLE_ROUTER_HOPCACHE_H_
 #define PFAEDLE_ROUTER_HOPCACHE_H_
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <set>
 #include <utility>
 #include "pfaedle/trgraph/Graph.h"
@@ -14,8 +16,22 @@
 namespace pfaedle {
 namespace router {
 
+/*
+ * Thread-safe cache of hop costs between edges. The entries are distributed
+ * over NUM_SHARDS shards, each guarded by its own lock, so concurrent
+ * accesses only contend if they hit the same shard.
+ *
+ * A cache may be bound to a shared cache, which then holds the hops whose
+ * costs do not depend on the routing attributes.
+ */
 class HopCache {
  public:
+  HopCache();
+
+  // Cache for a single set of routing attributes, backed by the cache
+  // shared, which holds hops independent of the routing attributes
+  explicit HopCache(HopCache* shared);
+
   void setMin(const trgraph::Edge* a, const trgraph::Edge* b, uint32_t val);
 
   void setMin(const trgraph::Edge* a, const std::set<trgraph::Edge*>& b,
@@ -29,8 +45,36 @@ class HopCache {
   std::pair<uint32_t, bool> get(const trgraph::Edge* a,
                                 const trgraph::Edge* b) const;
 
+  // Return the shared cache, or this cache if it is not bound to one
+  HopCache* getShared();
+
+  size_t getNumLookups() const { return _lookups; }
+
+  // number of lookups which returned an exact cost
+  size_t getNumHits() const { return _hits; }
+
+  // number of accesses which had to wait for another thread
+  size_t getNumContended() const { return _contended; }
+
+  static const size_t NUM_SHARDS = 64;
+
  private:
-  util::SparseMatrix<const trgraph::Edge*, int64_t, 0> _cache;
+  struct Shard {
+    std::mutex m;
+    util::SparseMatrix<const trgraph::Edge*, int64_t, 0> cache;
+  };
+
+  mutable Shard _shards[NUM_SHARDS];
+  HopCache* _shared;
+
+  mutable std::atomic<size_t> _lookups;
+  mutable std::atomic<size_t> _hits;
+  mutable std::atomic<size_t> _contended;
+
+  void set(const trgraph::Edge* a, const trgraph::Edge* b, int64_t val);
+
+  Shard& getShard(const trgraph::Edge* a, const trgraph::Edge* b) const;
+  std::unique_lock<std::mutex> lock(Shard* s) const;
 };
 
 }  // namespace router
@@ -5,8 +5,10 @@
 #ifndef PFAEDLE_ROUTER_ROUTER_H_
 #define PFAEDLE_ROUTER_ROUTER_H_
 
+#include <atomic>
 #include <limits>
 #include <map>
+#include <memory>
 #include <set>
 #include <stack>
 #include <string>
@@ -14,12 +16,16 @@
 #include <utility>
 #include <vector>
 #include "pfaedle/Def.h"
+#include "pfaedle/ThreadPool.h"
 #include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/CSRDijkstra.h"
+#include "pfaedle/router/ContractionHierarchy.h"
 #include "pfaedle/router/HopCache.h"
 #include "pfaedle/router/Misc.h"
 #include "pfaedle/router/RoutingAttrs.h"
 #include "pfaedle/router/TripTrie.h"
 #include "pfaedle/router/Weights.h"
+#include "pfaedle/trgraph/CSRGraph.h"
 #include "pfaedle/trgraph/Graph.h"
 #include "util/Misc.h"
 #include "util/geo/Geo.h"
@@ -39,15 +45,61 @@ typedef std::vector<double> LayerCostsDAG;
 typedef std::vector<LayerCostsDAG> CostsDAG;
 typedef std::vector<std::vector<size_t>> PredeDAG;
 
-typedef std::unordered_map<const trgraph::Edge*,
-                           std::unordered_map<const trgraph::Edge*, uint32_t>>
-    EdgeCostMatrix;
-typedef std::unordered_map<const trgraph::Edge*,
-                           std::unordered_map<const trgraph::Edge*, double>>
-    EdgeDistMatrix;
+// Edge list of a hop path, shared by all candidate pairs using it
+typedef std::shared_ptr<const EdgeList> EdgeListPtr;
+
+// Hop paths between the candidates of two layers, indexed like a CostMatrix
+typedef std::vector<EdgeListPtr> PathMatrix;
+
+// Per layer, the path to each candidate from its predecessor, if known
+typedef std::vector<std::vector<EdgeListPtr>> PathDAG;
+
 typedef util::graph::EDijkstra::EList<trgraph::NodePL, trgraph::EdgePL> TrEList;
 
-typedef std::vector<std::pair<std::pair<size_t, size_t>, uint32_t>> CostMatrix;
+/*
+ * Dense matrix of the hop costs between the candidates of two layers. Entry
+ * (i, j) holds the cost from the i-th candidate of the first to the j-th
+ * candidate of the second layer, or ROUTE_INF if there is no such hop.
+ */
+class CostMatrix {
+ public:
+  CostMatrix() : _rows(0), _cols(0) {}
+
+  // Resize to rows x cols and set all entries to ROUTE_INF. Memory is kept
+  // between calls, so a matrix can be reused for many layer transitions.
+  void reset(size_t rows, size_t cols) {
+    _rows = rows;
+    _cols = cols;
+    _vals.assign(rows * cols, ROUTE_INF);
+  }
+
+  size_t getRows() const { return _rows; }
+  size_t getCols() const { return _cols; }
+
+  uint32_t get(size_t i, size_t j) const { return _vals[i * _cols + j]; }
+  void set(size_t i, size_t j, uint32_t c) { _vals[i * _cols + j] = c; }
+
+  // The getCols() entries of row i
+  const uint32_t* getRow(size_t i) const { return _vals.data() + i * _cols; }
+
+ private:
+  size_t _rows, _cols;
+  std::vector<uint32_t> _vals;
+};
+
+// Hop matrices of a layer transition, reused by all transitions routed in
+// the same task
+struct HopBuffers {
+  CostMatrix costs;
+  CostMatrix dists;
+  PathMatrix paths;
+
+  // per candidate of the second layer, scratch for the layer update
+  std::vector<double> arrTimes;
+  std::vector<double> pens;
+  std::vector<double> travelTimes;
+  std::vector<double> weights;
+};
 
 class Router {
  public:
@@ -55,7 +107,15 @@ class Router {
   virtual std::map<size_t, EdgeListHops> route(
       const TripTrie<pfaedle::gtfs::Trip>* trie, const EdgeCandMap& ecm,
       const RoutingOpts& rOpts, const osm::Restrictor& rest, HopCache* hopCache,
-      bool noFastHops) const = 0;
+      bool noFastHops, bool parallelHops, size_t beamWidth,
+      ThreadPool* pool) const = 0;
+
+  // Number of candidates dropped by the beam so far
+  virtual size_t getNumBeamPruned() const = 0;
+
+  // Number of trip trie leafs so far for which the beam may have changed
+  // the most likely path
+  virtual size_t getNumBeamUncertain() const = 0;
 };
 
 /*
@@ -65,17 +125,58 @@ class Router {
 template <typename TW>
 class RouterImpl : public Router {
  public:
-  // Find the most likely path through the graph for a trip trie.
+  RouterImpl() : _csr(0), _ch(0), _beamPruned(0), _beamUncertain(0) {}
+
+  // Compute the n x n hops on the CSR view csr of the transit graph
+  explicit RouterImpl(const trgraph::CSRGraph* csr)
+      : _csr(csr), _ch(0), _beamPruned(0), _beamUncertain(0) {}
+
+  // Compute the n x n hops on the CSR view csr of the transit graph, using
+  // the lower bounds of the contraction hierarchy ch built on top of it
+  RouterImpl(const trgraph::CSRGraph* csr, const ContractionHierarchy* ch)
+      : _csr(csr), _ch(ch), _beamPruned(0), _beamUncertain(0) {}
+
+  // Find the most likely path through the graph for a trip trie. If pool
+  // is not null, sibling subtrees of the trie are routed in parallel. If
+  // parallelHops is also set, so are the sources of a single hop. If
+  // beamWidth is not 0, only the beamWidth cheapest candidates of each
+  // layer (and the null candidates) are routed from.
   virtual std::map<size_t, EdgeListHops> route(
       const TripTrie<pfaedle::gtfs::Trip>* trie, const EdgeCandMap& ecm,
       const RoutingOpts& rOpts, const osm::Restrictor& rest, HopCache* hopCache,
-      bool noFastHops) const;
+      bool noFastHops, bool parallelHops, size_t beamWidth,
+      ThreadPool* pool) const;
+
+  virtual size_t getNumBeamPruned() const { return _beamPruned; }
+  virtual size_t getNumBeamUncertain() const { return _beamUncertain; }
 
  private:
+  void routeSubtree(const TripTrie<pfaedle::gtfs::Trip>* trie,
+                    const EdgeCandMap& ecm, const RoutingOpts& rOpts,
+                    const osm::Restrictor& rest, HopCache* hopCache,
+                    bool noFastHops, size_t root, size_t beamWidth,
+                    ThreadPool* pool, ThreadPool* hopPool, HopBuffers* bufs,
+                    CostsDAG* costsDAG, PredeDAG* predeDAG,
+                    PathDAG* pathDAG, std::vector<double>* maxCosts,
+                    std::vector<double>* beamCuts) const;
+
+  void relaxHop(const TripTrie<pfaedle::gtfs::Trip>* trie,
+                const EdgeCandMap& ecm, const RoutingOpts& rOpts,
+                const osm::Restrictor& rest, HopCache* hopCache,
+                bool noFastHops, size_t frTrNid, size_t toTrNid,
+                const EdgeCandGroup& frCands, double maxSpeed,
+                ThreadPool* hopPool, HopBuffers* bufs,
+                CostsDAG* costsDAG, PredeDAG* predeDAG, PathDAG* pathDAG,
+                std::vector<double>* maxCosts) const;
+
+  // Compute the hop costs (and distances, if needed by TW) between two
+  // layers. If paths is not null, the paths found are kept there. Hops
+  // taken from the hop cache have no path
   void hops(const EdgeCandGroup& from, const EdgeCandGroup& to,
-            CostMatrix* rCosts, CostMatrix* dists, const RoutingAttrs& rAttrs,
-            const RoutingOpts& rOpts, const osm::Restrictor& rest,
-            HopCache* hopCache, uint32_t maxCost) const;
+            CostMatrix* rCosts, CostMatrix* dists, PathMatrix* paths,
+            const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
+            const osm::Restrictor& rest, HopCache* hopCache, uint32_t maxCost,
+            ThreadPool* pool) const;
 
   void hopsFast(const EdgeCandGroup& from, const EdgeCandGroup& to,
                 const LayerCostsDAG& initCosts, CostMatrix* rCosts,
@@ -84,6 +185,30 @@ class RouterImpl : public Router {
 
                 HopCache* hopCache, uint32_t maxCost) const;
 
+  // Compute the hops from eFrs[i] to eTos[j] for each j in remTos[i] and
+  // write them to the flat |eFrs| x |eTos| matrices ecm, ecmDist and, if
+  // not null, ecmPaths. Below MIN_MANY_TO_MANY_SRCS sources, each source is
+  // searched on its own with A*, otherwise all hops are searched at once.
+  void csrHops(const std::vector<trgraph::Edge*>& eFrs,
+               const std::vector<trgraph::Edge*>& eTos,
+               const std::vector<std::vector<size_t>>& remTos,
+               const typename TW::CostFunc& costF, const RoutingOpts& rOpts,
+               bool useCh, HopCache* hopCache, uint32_t maxCost,
+               ThreadPool* pool, std::vector<uint32_t>* ecm,
+               std::vector<double>* ecmDist,
+               std::vector<EdgeListPtr>* ecmPaths) const;
+
+  // Single shortest path from from to to on the CSR view, written to edgs
+  // starting with to, like EDijkstra does. Searched bidirectionally, distH
+  // must estimate the cost to to, srcH the cost from from.
+  uint32_t csrPath(const trgraph::Edge* from, const trgraph::Edge* to,
+                   const typename TW::CostFunc& costF,
+                   const typename TW::DistHeur& distH,
+                   const typename TW::DistHeur& srcH, EdgeList* edgs) const;
+
+  uint32_t pathCost(const std::vector<uint32_t>& path,
+                    const typename TW::CostFunc& costF) const;
+
   bool connected(const EdgeCand& from, const EdgeCandGroup& tos) const;
   bool connected(const EdgeCandGroup& froms, const EdgeCand& to) const;
 
@@ -92,7 +217,24 @@ class RouterImpl : public Router {
       HopCache* hopCache, const std::set<trgraph::Edge*>& froms,
       const trgraph::Edge* to, uint32_t maxCost) const;
 
+  // If cands has more than width candidates with an edge, copy it to beam
+  // with the edges of all but the width cheapest of them (by costs) set to
+  // null. Returns the number of dropped candidates, the lowest cost of
+  // them is written to cut.
+  size_t beamPrune(const EdgeCandGroup& cands, const LayerCostsDAG& costs,
+                   size_t width, EdgeCandGroup* beam, double* cut) const;
+
   uint32_t addNonOverflow(uint32_t a, uint32_t b) const;
+
+  // Below this number of sources, one goal-directed search per source
+  // settles fewer edges than the undirected many-to-many search
+  static const size_t MIN_MANY_TO_MANY_SRCS = 4;
+
+  const trgraph::CSRGraph* _csr;
+  const ContractionHierarchy* _ch;
+
+  mutable std::atomic<size_t> _beamPruned;
+  mutable std::atomic<size_t> _beamUncertain;
 };
 
 #include "pfaedle/router/Router.tpp"
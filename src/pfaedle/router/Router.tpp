@@ -9,6 +9,7 @@
 #define omp_get_num_procs() 1
 #endif
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <set>
@@ -24,164 +25,48 @@ template <typename TW>
 std::map<size_t, EdgeListHops> RouterImpl<TW>::route(
     const TripTrie<pfaedle::gtfs::Trip>* trie, const EdgeCandMap& ecm,
     const RoutingOpts& rOpts, const osm::Restrictor& rest, HopCache* hopCache,
-    bool noFastHops) const {
+    bool noFastHops, bool parallelHops, size_t beamWidth,
+    ThreadPool* pool) const {
   std::map<size_t, EdgeListHops> ret;
+  ThreadPool* hopPool = parallelHops ? pool : 0;
 
   // the current node costs in our DAG
   CostsDAG costsDAG(trie->getNds().size());
   PredeDAG predeDAG(trie->getNds().size());
+  PathDAG pathDAG(trie->getNds().size());
   std::vector<double> maxCosts(trie->getNds().size());
 
+  // per node, the lowest cost of a candidate dropped by the beam
+  std::vector<double> beamCuts(trie->getNds().size(), DBL_INF);
+
   // skip the root node, init all to inf
   for (size_t nid = 1; nid < trie->getNds().size(); nid++) {
     costsDAG[nid].resize(ecm.at(nid).size(), DBL_INF);
     predeDAG[nid].resize(ecm.at(nid).size(), NO_PREDE);
+    pathDAG[nid].resize(ecm.at(nid).size());
   }
 
-  std::stack<size_t> st;
-
   // init cost of all first childs
   for (size_t cnid : trie->getNd(0).childs) {
-    st.push(cnid);
     for (size_t frId = 0; frId < ecm.at(cnid).size(); frId++) {
       costsDAG[cnid][frId] = ecm.at(cnid)[frId].pen;
     }
   }
 
-  while (!st.empty()) {
-    size_t frTrNid = st.top();
-    st.pop();
-    const auto& frTrNd = trie->getNd(frTrNid);
-
-    // determine the max speed for this hop
-    double maxSpeed = 0;
-    for (size_t nid = 0; nid < ecm.at(frTrNid).size(); nid++) {
-      if (!ecm.at(frTrNid)[nid].e) continue;
-      if (ecm.at(frTrNid)[nid].e->getFrom()->pl().getComp().maxSpeed > maxSpeed)
-        maxSpeed = ecm.at(frTrNid)[nid].e->getFrom()->pl().getComp().maxSpeed;
-    }
-
-    for (size_t toTrNid : trie->getNd(frTrNid).childs) {
-      CostMatrix costM, dists;
-      const auto& toTrNd = trie->getNd(toTrNid);
-
-      if (frTrNd.arr && !toTrNd.arr) {
-        for (size_t toId = 0; toId < costsDAG[toTrNid].size(); toId++) {
-          auto toCand = ecm.at(toTrNid)[toId];
-          for (size_t frId : toCand.depPrede) {
-            double newC = costsDAG[frTrNid][frId] + ecm.at(toTrNid)[toId].pen;
-            if (newC < costsDAG[toTrNid][toId]) {
-              costsDAG[toTrNid][toId] = newC;
-              predeDAG[toTrNid][toId] = frId;
-            }
-          }
-        }
-        st.push(toTrNid);
-        continue;
-      }
-
-      const double avgDepT = frTrNd.accTime / frTrNd.trips;
-      const double avgArrT = toTrNd.accTime / toTrNd.trips;
-
-      double hopDist = 0;
-
-      hopDist = util::geo::haversine(frTrNd.lat, frTrNd.lng, toTrNd.lat,
-                                     toTrNd.lng);
-
-      double minTime = hopDist / maxSpeed;
-      double hopTime = avgArrT - avgDepT;
-
-      if (hopTime < minTime) hopTime = minTime;
-
-      uint32_t newMaxCost = TW::maxCost(hopTime, rOpts);
-      uint32_t maxCost = newMaxCost;
-
-      bool found = false;
-      int step = 0;
-
-      while (!found && step <= MAX_ROUTE_COST_DOUBLING_STEPS) {
-        maxCosts[toTrNid] = newMaxCost;
-        maxCost = newMaxCost;
-
-        // calculate n x n hops between layers
-        if (noFastHops || !TW::ALLOWS_FAST_ROUTE) {
-          hops(ecm.at(frTrNid), ecm.at(toTrNid), &costM, &dists, toTrNd.rAttrs,
-               rOpts, rest, hopCache, maxCost);
-        } else {
-          hopsFast(ecm.at(frTrNid), ecm.at(toTrNid), costsDAG[frTrNid], &costM,
-                   toTrNd.rAttrs, rOpts, rest, hopCache, maxCost);
-        }
-
-        for (size_t matrixI = 0; matrixI < costM.size(); matrixI++) {
-          const auto& mVal = costM[matrixI];
-          const size_t frId = mVal.first.first;
-          const size_t toId = mVal.first.second;
-          const uint32_t c = mVal.second;
-
-          double mDist = 0;
-
-          // the dists and the costM matrices have entries at exactly the same
-          // loc
-          if (TW::NEED_DIST) mDist = dists[matrixI].second;
-
-          // calculate the transition weights
-          const double depT = ecm.at(frTrNid)[frId].time;
-          const double arrT = ecm.at(toTrNid)[toId].time;
-          const double w = TW::weight(c, mDist, arrT - depT, hopDist, rOpts);
-
-          // update costs to successors in next layer
-          double newC = costsDAG[frTrNid][frId] + ecm.at(toTrNid)[toId].pen + w;
-          if (newC < costsDAG[toTrNid][toId]) {
-            costsDAG[toTrNid][toId] = newC;
-            predeDAG[toTrNid][toId] = frId;
-            found = true;
-          }
-        }
-
-        if (newMaxCost <= std::numeric_limits<uint32_t>::max() / 2)
-          newMaxCost *= 2;
-        else
-          newMaxCost = std::numeric_limits<uint32_t>::max();
-
-        if (newMaxCost == maxCost) break;
-        step++;
-      }
-
-      if (!found) {
-        // write the cost for the NULL candidates as a fallback
-        LOG(VDEBUG) << "No routing path found between layers (trie node " 
-                    << frTrNid << " to " << toTrNid << "), using fallback to null candidates";
-        for (size_t frNid = 0; frNid < ecm.at(frTrNid).size(); frNid++) {
-          double newC = costsDAG[frTrNid][frNid] + maxCost * 100;
-          // in the time expanded case, there might be multiple null cands
-          size_t nullCId = 0;
-          while (nullCId < ecm.at(toTrNid).size() &&
-                 !ecm.at(toTrNid)[nullCId].e) {
-            if (newC < costsDAG[toTrNid][nullCId]) {
-              predeDAG[toTrNid][nullCId] = frNid;
-              costsDAG[toTrNid][nullCId] = newC;
-            }
-            nullCId++;
-          }
-        }
-
-        // for the remaining, write dummy edges
-        for (size_t frNid = 0; frNid < ecm.at(frTrNid).size(); frNid++) {
-          // skip NULL candidates
-          size_t toNid = 1;
-          while (toNid < ecm.at(toTrNid).size() && !ecm.at(toTrNid)[toNid].e)
-            toNid++;
-          for (; toNid < ecm.at(toTrNid).size(); toNid++) {
-            double newC = costsDAG[frTrNid][frNid] + ecm.at(toTrNid)[toNid].pen;
-            if (newC < costsDAG[toTrNid][toNid]) {
-              predeDAG[toTrNid][toNid] = frNid;
-              costsDAG[toTrNid][toNid] = newC;
-            }
-          }
-        }
-      }
-
-      st.push(toTrNid);
+  const auto& firstChilds = trie->getNd(0).childs;
+  if (pool && firstChilds.size() > 1) {
+    pool->run(firstChilds.size(), [&](size_t i) {
+      HopBuffers bufs;
+      routeSubtree(trie, ecm, rOpts, rest, hopCache, noFastHops,
+                   firstChilds[i], beamWidth, pool, hopPool, &bufs,
+                   &costsDAG, &predeDAG, &pathDAG, &maxCosts, &beamCuts);
+    });
+  } else {
+    HopBuffers bufs;
+    for (size_t cnid : firstChilds) {
+      routeSubtree(trie, ecm, rOpts, rest, hopCache, noFastHops, cnid,
+                   beamWidth, pool, hopPool, &bufs, &costsDAG, &predeDAG,
+                   &pathDAG, &maxCosts, &beamCuts);
     }
   }
 
@@ -201,6 +86,20 @@ std::map<size_t, EdgeListHops> RouterImpl<TW>::route(
     }
   }
 
+  if (beamWidth) {
+    // costs never decrease along a path, so the beam can only have changed
+    // the result for a leaf if a dropped candidate on the way to it was
+    // cheaper than the best path found
+    for (auto leaf : trie->getNdTrips()) {
+      double cut = DBL_INF;
+      for (size_t nid = trie->getNd(leaf.first).parent; nid != 0;
+           nid = trie->getNd(nid).parent) {
+        if (beamCuts[nid] < cut) cut = beamCuts[nid];
+      }
+      if (cut < sinkCosts[leaf.first]) _beamUncertain++;
+    }
+  }
+
   // retrieve edges
   for (auto leaf : trie->getNdTrips()) {
     const auto leafNid = leaf.first;
@@ -229,7 +128,15 @@ std::map<size_t, EdgeListHops> RouterImpl<TW>::route(
       // for subtracting and adding progression costs
       typename TW::CostFunc costPr(toTrNd.rAttrs, rOpts, rest, ROUTE_INF);
 
-      if (fr.e && to.e) {
+      const EdgeListPtr& path = pathDAG[curTrieNid][toId];
+
+      if (fr.e && to.e && path) {
+        // the path was already found during the hop calculation
+        ret[leafNid].push_back(
+            {*path, fr.e, to.e, fr.progr, to.progr, {}, {}});
+      } else if (fr.e && to.e) {
+        // the path was not kept (cached or fast hop), route it again
+
         // account for max progression start offset, do this exactly like
         // in the hops calculation to ensure that we can find the path again
         double maxProgrStart = 0;
@@ -252,8 +159,14 @@ std::map<size_t, EdgeListHops> RouterImpl<TW>::route(
         typename TW::DistHeur distH(fr.e->getFrom()->pl().getComp().maxSpeed,
                                     rOpts, {to.e});
 
-        const double c =
-            EDijkstra::shortestPath(fr.e, to.e, cost, distH, &edgs);
+        double c;
+        if (_csr) {
+          typename TW::DistHeur srcH(fr.e->getFrom()->pl().getComp().maxSpeed,
+                                     rOpts, {fr.e});
+          c = csrPath(fr.e, to.e, cost, distH, srcH, &edgs);
+        } else {
+          c = EDijkstra::shortestPath(fr.e, to.e, cost, distH, &edgs);
+        }
 
         if (c < maxCostRtInt) {
           // a path was found, use it
@@ -285,28 +198,278 @@ std::map<size_t, EdgeListHops> RouterImpl<TW>::route(
   return ret;
 }
 
+// _____________________________________________________________________________
+template <typename TW>
+void RouterImpl<TW>::routeSubtree(
+    const TripTrie<pfaedle::gtfs::Trip>* trie, const EdgeCandMap& ecm,
+    const RoutingOpts& rOpts, const osm::Restrictor& rest, HopCache* hopCache,
+    bool noFastHops, size_t root, size_t beamWidth, ThreadPool* pool,
+    ThreadPool* hopPool, HopBuffers* bufs, CostsDAG* costsDAG,
+    PredeDAG* predeDAG, PathDAG* pathDAG, std::vector<double>* maxCosts,
+    std::vector<double>* beamCuts) const {
+  std::stack<size_t> st;
+  st.push(root);
+
+  while (!st.empty()) {
+    size_t frTrNid = st.top();
+    st.pop();
+
+    // determine the max speed for this hop
+    double maxSpeed = 0;
+    for (size_t nid = 0; nid < ecm.at(frTrNid).size(); nid++) {
+      if (!ecm.at(frTrNid)[nid].e) continue;
+      if (ecm.at(frTrNid)[nid].e->getFrom()->pl().getComp().maxSpeed > maxSpeed)
+        maxSpeed = ecm.at(frTrNid)[nid].e->getFrom()->pl().getComp().maxSpeed;
+    }
+
+    const auto& childs = trie->getNd(frTrNid).childs;
+
+    // the layer of frTrNid is final, only route from its beam
+    const EdgeCandGroup* frCands = &ecm.at(frTrNid);
+    EdgeCandGroup beam;
+    if (beamWidth && !childs.empty()) {
+      const size_t pruned = beamPrune(ecm.at(frTrNid), (*costsDAG)[frTrNid],
+                                      beamWidth, &beam,
+                                      &(*beamCuts)[frTrNid]);
+      if (pruned) {
+        frCands = &beam;
+        _beamPruned += pruned;
+      }
+    }
+
+    if (pool && childs.size() > 1) {
+      // the layer of frTrNid is final, and each child layer is only ever
+      // written from its parent, so sibling subtrees are independent
+      pool->run(childs.size(), [&](size_t i) {
+        HopBuffers forkBufs;
+        relaxHop(trie, ecm, rOpts, rest, hopCache, noFastHops, frTrNid,
+                 childs[i], *frCands, maxSpeed, hopPool, &forkBufs, costsDAG,
+                 predeDAG, pathDAG, maxCosts);
+        routeSubtree(trie, ecm, rOpts, rest, hopCache, noFastHops, childs[i],
+                     beamWidth, pool, hopPool, &forkBufs, costsDAG, predeDAG,
+                     pathDAG, maxCosts, beamCuts);
+      });
+      continue;
+    }
+
+    for (size_t toTrNid : childs) {
+      relaxHop(trie, ecm, rOpts, rest, hopCache, noFastHops, frTrNid, toTrNid,
+               *frCands, maxSpeed, hopPool, bufs, costsDAG, predeDAG, pathDAG,
+               maxCosts);
+      st.push(toTrNid);
+    }
+  }
+}
+
+// _____________________________________________________________________________
+template <typename TW>
+void RouterImpl<TW>::relaxHop(
+    const TripTrie<pfaedle::gtfs::Trip>* trie, const EdgeCandMap& ecm,
+    const RoutingOpts& rOpts, const osm::Restrictor& rest, HopCache* hopCache,
+    bool noFastHops, size_t frTrNid, size_t toTrNid,
+    const EdgeCandGroup& frCands, double maxSpeed, ThreadPool* hopPool,
+    HopBuffers* bufs, CostsDAG* costsDAG,
+    PredeDAG* predeDAG, PathDAG* pathDAG,
+    std::vector<double>* maxCosts) const {
+  const auto& frTrNd = trie->getNd(frTrNid);
+  const auto& toTrNd = trie->getNd(toTrNid);
+  CostMatrix& costM = bufs->costs;
+  CostMatrix& dists = bufs->dists;
+  PathMatrix& paths = bufs->paths;
+
+  if (frTrNd.arr && !toTrNd.arr) {
+    for (size_t toId = 0; toId < (*costsDAG)[toTrNid].size(); toId++) {
+      auto toCand = ecm.at(toTrNid)[toId];
+      for (size_t frId : toCand.depPrede) {
+        double newC = (*costsDAG)[frTrNid][frId] + ecm.at(toTrNid)[toId].pen;
+        if (newC < (*costsDAG)[toTrNid][toId]) {
+          (*costsDAG)[toTrNid][toId] = newC;
+          (*predeDAG)[toTrNid][toId] = frId;
+        }
+      }
+    }
+    return;
+  }
+
+  const double avgDepT = frTrNd.accTime / frTrNd.trips;
+  const double avgArrT = toTrNd.accTime / toTrNd.trips;
+
+  double hopDist = 0;
+
+  hopDist = util::geo::haversine(frTrNd.lat, frTrNd.lng, toTrNd.lat,
+                                 toTrNd.lng);
+
+  double minTime = hopDist / maxSpeed;
+  double hopTime = avgArrT - avgDepT;
+
+  if (hopTime < minTime) hopTime = minTime;
+
+  uint32_t newMaxCost = TW::maxCost(hopTime, rOpts);
+  uint32_t maxCost = newMaxCost;
+
+  // if the costs do not depend on the routing attributes, the hops can
+  // be shared with all other tries
+  HopCache* cache = hopCache;
+  const typename TW::CostFunc attrCostF(toTrNd.rAttrs, rOpts, rest,
+                                        ROUTE_INF);
+  if (hopCache && attrCostF._noLineSimiPen) cache = hopCache->getShared();
+
+  bool found = false;
+  int step = 0;
+
+  while (!found && step <= MAX_ROUTE_COST_DOUBLING_STEPS) {
+    (*maxCosts)[toTrNid] = newMaxCost;
+    maxCost = newMaxCost;
+
+    // calculate n x n hops between layers
+    if (noFastHops || !TW::ALLOWS_FAST_ROUTE) {
+      hops(frCands, ecm.at(toTrNid), &costM, &dists, &paths,
+           toTrNd.rAttrs, rOpts, rest, cache, maxCost, hopPool);
+    } else {
+      // the fast hops do not keep paths, they are routed again at the end
+      paths.clear();
+      hopsFast(frCands, ecm.at(toTrNid), (*costsDAG)[frTrNid], &costM,
+               toTrNd.rAttrs, rOpts, rest, cache, maxCost);
+    }
+
+    const auto& toCands = ecm.at(toTrNid);
+    const LayerCostsDAG& frCosts = (*costsDAG)[frTrNid];
+    LayerCostsDAG& toCosts = (*costsDAG)[toTrNid];
+    std::vector<size_t>& toPredes = (*predeDAG)[toTrNid];
+    const size_t nTo = costM.getCols();
+
+    std::vector<double>& arrTs = bufs->arrTimes;
+    std::vector<double>& pens = bufs->pens;
+    std::vector<double>& ts = bufs->travelTimes;
+    std::vector<double>& ws = bufs->weights;
+    arrTs.resize(nTo);
+    pens.resize(nTo);
+    ts.resize(nTo);
+    ws.resize(nTo);
+
+    for (size_t toId = 0; toId < nTo; toId++) {
+      arrTs[toId] = toCands[toId].time;
+      pens[toId] = toCands[toId].pen;
+    }
+
+    // update costs to successors in next layer, one row of the (min, +)
+    // product at a time. All loops below are branch free and run over
+    // contiguous memory, so the compiler can vectorize them. Per
+    // successor, the first predecessor with the minimal cost wins
+    for (size_t frId = 0; frId < costM.getRows(); frId++) {
+      const uint32_t* cs = costM.getRow(frId);
+
+      // both matrices are indexed by candidate position
+      const uint32_t* ds = TW::NEED_DIST ? dists.getRow(frId) : 0;
+
+      // calculate the transition weights
+      const double depT = frCands[frId].time;
+      for (size_t toId = 0; toId < nTo; toId++) ts[toId] = arrTs[toId] - depT;
+      TW::weights(cs, ds, ts.data(), hopDist, rOpts, nTo, ws.data());
+
+      const double frC = frCosts[frId];
+      bool better = false;
+      for (size_t toId = 0; toId < nTo; toId++) {
+        const double newC =
+            cs[toId] == ROUTE_INF ? DBL_INF : frC + pens[toId] + ws[toId];
+        const bool b = newC < toCosts[toId];
+        toCosts[toId] = b ? newC : toCosts[toId];
+        toPredes[toId] = b ? frId : toPredes[toId];
+        better |= b;
+      }
+      found |= better;
+    }
+
+    if (newMaxCost <= std::numeric_limits<uint32_t>::max() / 2)
+      newMaxCost *= 2;
+    else
+      newMaxCost = std::numeric_limits<uint32_t>::max();
+
+    if (newMaxCost == maxCost) break;
+    step++;
+  }
+
+  // keep the paths of the chosen hops, all of them stem from the last
+  // iteration above
+  if (found && !paths.empty()) {
+    for (size_t toId = 0; toId < (*predeDAG)[toTrNid].size(); toId++) {
+      const size_t frId = (*predeDAG)[toTrNid][toId];
+      if (frId == NO_PREDE) continue;
+      (*pathDAG)[toTrNid][toId] = paths[frId * costM.getCols() + toId];
+    }
+  }
+
+  if (!found) {
+    // write the cost for the NULL candidates as a fallback
+    LOG(VDEBUG) << "No routing path found between layers (trie node " 
+                << frTrNid << " to " << toTrNid << "), using fallback to null candidates";
+    for (size_t frNid = 0; frNid < ecm.at(frTrNid).size(); frNid++) {
+      double newC = (*costsDAG)[frTrNid][frNid] + maxCost * 100;
+      // in the time expanded case, there might be multiple null cands
+      size_t nullCId = 0;
+      while (nullCId < ecm.at(toTrNid).size() &&
+             !ecm.at(toTrNid)[nullCId].e) {
+        if (newC < (*costsDAG)[toTrNid][nullCId]) {
+          (*predeDAG)[toTrNid][nullCId] = frNid;
+          (*costsDAG)[toTrNid][nullCId] = newC;
+        }
+        nullCId++;
+      }
+    }
+
+    // for the remaining, write dummy edges
+    for (size_t frNid = 0; frNid < ecm.at(frTrNid).size(); frNid++) {
+      // skip NULL candidates
+      size_t toNid = 1;
+      while (toNid < ecm.at(toTrNid).size() && !ecm.at(toTrNid)[toNid].e)
+        toNid++;
+      for (; toNid < ecm.at(toTrNid).size(); toNid++) {
+        double newC = (*costsDAG)[frTrNid][frNid] + ecm.at(toTrNid)[toNid].pen;
+        if (newC < (*costsDAG)[toTrNid][toNid]) {
+          (*predeDAG)[toTrNid][toNid] = frNid;
+          (*costsDAG)[toTrNid][toNid] = newC;
+        }
+      }
+    }
+  }
+}
+
 // _____________________________________________________________________________
 template <typename TW>
 void RouterImpl<TW>::hops(const EdgeCandGroup& froms, const EdgeCandGroup& tos,
                           CostMatrix* rCosts, CostMatrix* dists,
-                          const RoutingAttrs& rAttrs, const RoutingOpts& rOpts,
+                          PathMatrix* rPaths, const RoutingAttrs& rAttrs,
+                          const RoutingOpts& rOpts,
                           const osm::Restrictor& rest, HopCache* hopCache,
-                          uint32_t maxCost) const {
-  // standard 1 -> n approach
-  std::set<trgraph::Edge*> eFrs;
+                          uint32_t maxCost, ThreadPool* pool) const {
+  rCosts->reset(froms.size(), tos.size());
+  if (TW::NEED_DIST) dists->reset(froms.size(), tos.size());
+  if (rPaths) rPaths->assign(froms.size() * tos.size(), EdgeListPtr());
+
+  // standard 1 -> n approach, on the distinct edges of both layers. The
+  // edge matrices below are indexed by the position of the edges here
+  std::vector<trgraph::Edge*> eFrs;
   for (const auto& from : froms) {
     if (!from.e) continue;
-    eFrs.insert(from.e);
+    eFrs.push_back(from.e);
   }
 
-  std::set<trgraph::Edge*> eTos;
+  std::vector<trgraph::Edge*> eTos;
   for (const auto& to : tos) {
     if (!to.e) continue;
-    eTos.insert(to.e);
+    eTos.push_back(to.e);
   }
 
-  EdgeCostMatrix ecm;
-  EdgeDistMatrix ecmDist;
+  std::sort(eFrs.begin(), eFrs.end());
+  eFrs.erase(std::unique(eFrs.begin(), eFrs.end()), eFrs.end());
+  std::sort(eTos.begin(), eTos.end());
+  eTos.erase(std::unique(eTos.begin(), eTos.end()), eTos.end());
+
+  const size_t nt = eTos.size();
+
+  std::vector<uint32_t> ecm(eFrs.size() * nt, 0);
+  std::vector<double> ecmDist(TW::NEED_DIST ? eFrs.size() * nt : 0, ROUTE_INF);
+  std::vector<EdgeListPtr> ecmPaths(rPaths ? eFrs.size() * nt : 0);
 
   // account for max progression start offset
   double maxProgrStart = 0;
@@ -321,11 +484,16 @@ void RouterImpl<TW>::hops(const EdgeCandGroup& froms, const EdgeCandGroup& tos,
   maxCost = addNonOverflow(maxCost, maxProgrStart);
   typename TW::CostFunc costF(rAttrs, rOpts, rest, maxCost);
 
-  for (trgraph::Edge* eFrom : eFrs) {
-    std::set<trgraph::Edge*> remTos;
-    for (trgraph::Edge* eTo : eTos) {
-      // init ecmDist
-      ecmDist[eFrom][eTo] = ROUTE_INF;
+  const bool useCh = _csr && _ch && _ch->isLowerBound(rOpts, rest);
+
+  // per from edge, the positions of the to edges still to be searched
+  std::vector<std::vector<size_t>> remTos(eFrs.size());
+  bool searchNeeded = false;
+
+  for (size_t i = 0; i < eFrs.size(); i++) {
+    trgraph::Edge* eFrom = eFrs[i];
+    for (size_t j = 0; j < nt; j++) {
+      trgraph::Edge* eTo = eTos[j];
 
       std::pair<uint32_t, bool> cached = {0, 0};
       if (hopCache) cached = hopCache->get(eFrom, eTo);
@@ -334,49 +502,77 @@ void RouterImpl<TW>::hops(const EdgeCandGroup& froms, const EdgeCandGroup& tos,
       // the distance between them is trivially infinite
       if (eFrom->getFrom()->pl().getCompId() !=
           eTo->getTo()->pl().getCompId()) {
-        ecm[eFrom][eTo] = costF.inf();
+        ecm[i * nt + j] = costF.inf();
       } else if (cached.second >= costF.inf()) {
-        ecm[eFrom][eTo] = costF.inf();
+        ecm[i * nt + j] = costF.inf();
       } else if (!TW::NEED_DIST && cached.second) {
-        ecm[eFrom][eTo] = cached.first;
+        ecm[i * nt + j] = cached.first;
       } else {
-        remTos.insert(eTo);
+        remTos[i].push_back(j);
+        searchNeeded = true;
       }
     }
+  }
 
-    if (remTos.size()) {
+  if (_csr) {
+    // all remaining hops in a single many-to-many search
+    if (searchNeeded)
+      csrHops(eFrs, eTos, remTos, costF, rOpts, useCh, hopCache, maxCost, pool,
+              &ecm, &ecmDist, rPaths ? &ecmPaths : 0);
+  } else if (searchNeeded) {
+    // each search only writes the row of its source edge
+    auto search = [&](size_t i) {
+      if (remTos[i].empty()) return;
+      trgraph::Edge* eFrom = eFrs[i];
+
+      std::set<trgraph::Edge*> remTo;
+      for (size_t j : remTos[i]) remTo.insert(eTos[j]);
+
+      // the cost function caches the last edge, use a copy per search
+      const typename TW::CostFunc srcCostF(costF);
       typename TW::DistHeur distH(eFrom->getFrom()->pl().getComp().maxSpeed,
-                                  rOpts, remTos);
+                                  rOpts, remTo);
 
       std::unordered_map<trgraph::Edge*, TrEList> paths;
       std::unordered_map<trgraph::Edge*, TrEList*> pathPtrs;
       for (auto to : tos) pathPtrs[to.e] = &paths[to.e];
 
       const auto& costs =
-          EDijkstra::shortestPath(eFrom, remTos, costF, distH, pathPtrs);
+          EDijkstra::shortestPath(eFrom, remTo, srcCostF, distH, pathPtrs);
 
-      for (const auto& c : costs) {
-        ecm[eFrom][c.first] = c.second;
+      for (size_t j : remTos[i]) {
+        trgraph::Edge* eTo = eTos[j];
+        const auto cIt = costs.find(eTo);
+        const uint32_t c = cIt == costs.end() ? costF.inf() : cIt->second;
+        ecm[i * nt + j] = c;
 
-        if (paths[c.first].size() == 0) {
-          if (hopCache) hopCache->setMin(eFrom, c.first, maxCost);
+        if (paths[eTo].size() == 0) {
+          if (hopCache) hopCache->setMin(eFrom, eTo, maxCost);
           continue;  // no path found
         }
 
-        if (hopCache) hopCache->setEx(eFrom, c.first, c.second);
-      }
+        if (hopCache) hopCache->setEx(eFrom, eTo, c);
 
-      if (TW::NEED_DIST) {
-        for (const auto& c : costs) {
-          if (!paths[c.first].size()) continue;
+        if (TW::NEED_DIST) {
           double d = 0;
           // don't count last edge
-          for (size_t i = paths[c.first].size() - 1; i > 0; i--) {
-            d += paths[c.first][i]->pl().getLength();
+          for (size_t k = paths[eTo].size() - 1; k > 0; k--) {
+            d += paths[eTo][k]->pl().getLength();
           }
-          ecmDist[eFrom][c.first] = d;
+          ecmDist[i * nt + j] = d;
+        }
+
+        if (rPaths) {
+          ecmPaths[i * nt + j] =
+              std::make_shared<const EdgeList>(std::move(paths[eTo]));
         }
       }
+    };
+
+    if (pool && eFrs.size() > 1) {
+      pool->run(eFrs.size(), search);
+    } else {
+      for (size_t i = 0; i < eFrs.size(); i++) search(i);
     }
   }
 
@@ -385,16 +581,20 @@ void RouterImpl<TW>::hops(const EdgeCandGroup& froms, const EdgeCandGroup& tos,
     auto fr = froms[frId];
     if (!fr.e) continue;
     auto costFr = costF(fr.e, 0, 0);
+    const size_t i =
+        std::lower_bound(eFrs.begin(), eFrs.end(), fr.e) - eFrs.begin();
     for (size_t toId = 0; toId < tos.size(); toId++) {
       auto to = tos[toId];
       if (!to.e) continue;
+      const size_t j =
+          std::lower_bound(eTos.begin(), eTos.end(), to.e) - eTos.begin();
 
-      uint32_t c = ecm[fr.e][to.e];
+      uint32_t c = ecm[i * nt + j];
 
       if (c >= maxCost) continue;
 
       double dist = 0;
-      if (TW::NEED_DIST) dist = ecmDist[fr.e][to.e];
+      if (TW::NEED_DIST) dist = ecmDist[i * nt + j];
 
       if (fr.e == to.e) {
         if (fr.progr <= to.progr) {
@@ -427,14 +627,221 @@ void RouterImpl<TW>::hops(const EdgeCandGroup& froms, const EdgeCandGroup& tos,
       }
 
       if (c < maxCost - maxProgrStart) {
-        rCosts->push_back({{frId, toId}, c});
-        if (TW::NEED_DIST)
-          dists->push_back({{frId, toId}, static_cast<uint32_t>(dist)});
+        rCosts->set(frId, toId, c);
+        if (rPaths) (*rPaths)[frId * tos.size() + toId] = ecmPaths[i * nt + j];
+        if (TW::NEED_DIST) dists->set(frId, toId, static_cast<uint32_t>(dist));
+      }
+    }
+  }
+}
+
+// _____________________________________________________________________________
+template <typename TW>
+void RouterImpl<TW>::csrHops(
+    const std::vector<trgraph::Edge*>& eFrs,
+    const std::vector<trgraph::Edge*>& eTos,
+    const std::vector<std::vector<size_t>>& remTos,
+    const typename TW::CostFunc& costF, const RoutingOpts& rOpts, bool useCh,
+    HopCache* hopCache, uint32_t maxCost, ThreadPool* pool,
+    std::vector<uint32_t>* ecm, std::vector<double>* ecmDist,
+    std::vector<EdgeListPtr>* ecmPaths) const {
+  const size_t nt = eTos.size();
+
+  // only search from and to the edges which have remaining hops, srcs and
+  // tgts hold their positions in eFrs and eTos
+  std::vector<size_t> srcs;
+  std::vector<uint32_t> frIds;
+  std::vector<size_t> tgts;
+  std::vector<uint32_t> toIds;
+  const size_t noTgt = std::numeric_limits<size_t>::max();
+  std::vector<size_t> tgtIdx(nt, noTgt);
+
+  for (size_t i = 0; i < eFrs.size(); i++) {
+    if (remTos[i].empty()) continue;
+    srcs.push_back(i);
+    frIds.push_back(_csr->getId(eFrs[i]));
+    for (size_t j : remTos[i]) {
+      if (tgtIdx[j] != noTgt) continue;
+      tgtIdx[j] = tgts.size();
+      tgts.push_back(j);
+      toIds.push_back(_csr->getId(eTos[j]));
+    }
+  }
+
+  const size_t ntg = tgts.size();
+
+  std::vector<uint32_t> costs;
+  std::vector<std::vector<uint32_t>> paths;
+
+  if (useCh) {
+    _ch->shortestPaths(frIds, toIds, costF.inf(), &costs, &paths);
+
+    // the base costs are lower bounds, so they are exact if the path found
+    // is not punished by the line similarity. Otherwise, fall back to a
+    // full search for these targets. Each source only touches its own
+    // row of the matrices, so the sources can be searched concurrently
+    auto fallback = [&](size_t s) {
+      // the cost function caches the last edge, use a copy per source
+      const typename TW::CostFunc srcCostF(costF);
+
+      std::vector<size_t> idx;
+      std::vector<uint32_t> fbToIds;
+      std::set<trgraph::Edge*> fbTos;
+      for (size_t j : remTos[srcs[s]]) {
+        const size_t k = s * ntg + tgtIdx[j];
+        if (costs[k] >= srcCostF.inf() ||
+            pathCost(paths[k], srcCostF) == costs[k])
+          continue;
+        idx.push_back(k);
+        fbToIds.push_back(toIds[tgtIdx[j]]);
+        fbTos.insert(eTos[j]);
+      }
+
+      if (fbToIds.empty()) return;
+
+      typename TW::DistHeur distH(
+          eFrs[srcs[s]]->getFrom()->pl().getComp().maxSpeed, rOpts, fbTos);
+
+      std::vector<uint32_t> fbCosts;
+      std::vector<std::vector<uint32_t>> fbPaths;
+      CSRDijkstra::shortestPath(*_csr, frIds[s], fbToIds, srcCostF, distH,
+                                &fbCosts, &fbPaths);
+      for (size_t k = 0; k < idx.size(); k++) {
+        costs[idx[k]] = fbCosts[k];
+        paths[idx[k]].swap(fbPaths[k]);
+      }
+    };
+
+    if (pool && srcs.size() > 1) {
+      pool->run(srcs.size(), fallback);
+    } else {
+      for (size_t s = 0; s < srcs.size(); s++) fallback(s);
+    }
+  } else if (srcs.size() < MIN_MANY_TO_MANY_SRCS) {
+    costs.assign(srcs.size() * ntg, costF.inf());
+    paths.resize(srcs.size() * ntg);
+
+    // each source only touches its own row of the matrices
+    auto search = [&](size_t s) {
+      // the cost function caches the last edge, use a copy per source
+      const typename TW::CostFunc srcCostF(costF);
+
+      std::vector<uint32_t> srcToIds;
+      std::set<trgraph::Edge*> srcTos;
+      for (size_t j : remTos[srcs[s]]) {
+        srcToIds.push_back(toIds[tgtIdx[j]]);
+        srcTos.insert(eTos[j]);
+      }
+
+      typename TW::DistHeur distH(
+          eFrs[srcs[s]]->getFrom()->pl().getComp().maxSpeed, rOpts, srcTos);
+
+      std::vector<uint32_t> srcCosts;
+      std::vector<std::vector<uint32_t>> srcPaths;
+      CSRDijkstra::shortestPath(*_csr, frIds[s], srcToIds, srcCostF, distH,
+                                &srcCosts,
+                                TW::NEED_DIST || ecmPaths ? &srcPaths : 0);
+
+      size_t k = 0;
+      for (size_t j : remTos[srcs[s]]) {
+        const size_t idx = s * ntg + tgtIdx[j];
+        costs[idx] = srcCosts[k];
+        if (!srcPaths.empty()) paths[idx].swap(srcPaths[k]);
+        k++;
+      }
+    };
+
+    if (pool && srcs.size() > 1) {
+      pool->run(srcs.size(), search);
+    } else {
+      for (size_t s = 0; s < srcs.size(); s++) search(s);
+    }
+  } else {
+    // the fastest speed of any source bounds the heuristics of all pairs
+    double maxSpeed = 0;
+    std::set<trgraph::Edge*> frs, tos;
+    for (size_t i : srcs) {
+      frs.insert(eFrs[i]);
+      const double speed = eFrs[i]->getFrom()->pl().getComp().maxSpeed;
+      if (speed > maxSpeed) maxSpeed = speed;
+    }
+    for (size_t j : tgts) tos.insert(eTos[j]);
+
+    typename TW::DistHeur distH(maxSpeed, rOpts, tos);
+    typename TW::DistHeur srcH(maxSpeed, rOpts, frs);
+
+    CSRDijkstra::shortestPaths(*_csr, frIds, toIds, costF, distH, srcH, &costs,
+                               TW::NEED_DIST || ecmPaths ? &paths : 0);
+  }
+
+  for (size_t s = 0; s < srcs.size(); s++) {
+    const size_t i = srcs[s];
+    trgraph::Edge* eFrom = eFrs[i];
+    for (size_t j : remTos[i]) {
+      const size_t k = s * ntg + tgtIdx[j];
+      const uint32_t c = costs[k];
+      (*ecm)[i * nt + j] = c;
+
+      if (c >= costF.inf()) {
+        if (hopCache) hopCache->setMin(eFrom, eTos[j], maxCost);
+        continue;
+      }
+
+      if (hopCache) hopCache->setEx(eFrom, eTos[j], c);
+
+      if (TW::NEED_DIST) {
+        double d = 0;
+        // don't count last edge
+        for (size_t l = paths[k].size() - 1; l > 0; l--) {
+          d += _csr->getLength(paths[k][l]);
+        }
+        (*ecmDist)[i * nt + j] = d;
+      }
+
+      if (ecmPaths) {
+        // the view only hands out const edges
+        EdgeList edgs;
+        edgs.reserve(paths[k].size());
+        for (uint32_t e : paths[k])
+          edgs.push_back(const_cast<trgraph::Edge*>(_csr->getEdg(e)));
+        (*ecmPaths)[i * nt + j] =
+            std::make_shared<const EdgeList>(std::move(edgs));
       }
     }
   }
 }
 
+// _____________________________________________________________________________
+template <typename TW>
+uint32_t RouterImpl<TW>::csrPath(const trgraph::Edge* from,
+                                 const trgraph::Edge* to,
+                                 const typename TW::CostFunc& costF,
+                                 const typename TW::DistHeur& distH,
+                                 const typename TW::DistHeur& srcH,
+                                 EdgeList* edgs) const {
+  std::vector<uint32_t> path;
+
+  const uint32_t c = CSRDijkstra::shortestPathBidir(
+      *_csr, _csr->getId(from), _csr->getId(to), costF, distH, srcH, &path);
+
+  // the view only hands out const edges
+  for (uint32_t e : path)
+    edgs->push_back(const_cast<trgraph::Edge*>(_csr->getEdg(e)));
+
+  return c;
+}
+
+// _____________________________________________________________________________
+template <typename TW>
+uint32_t RouterImpl<TW>::pathCost(const std::vector<uint32_t>& path,
+                                  const typename TW::CostFunc& costF) const {
+  uint32_t c = 0;
+  for (size_t i = path.size() - 1; i > 0; i--) {
+    c = addNonOverflow(c, costF(*_csr, path[i], path[i - 1]));
+  }
+  return c;
+}
+
 // _____________________________________________________________________________
 template <typename TW>
 void RouterImpl<TW>::hopsFast(const EdgeCandGroup& froms,
@@ -444,6 +851,8 @@ void RouterImpl<TW>::hopsFast(const EdgeCandGroup& froms,
                               const RoutingOpts& rOpts,
                               const osm::Restrictor& restr, HopCache* hopCache,
                               uint32_t maxCost) const {
+  rCosts->reset(froms.size(), tos.size());
+
   std::unordered_map<trgraph::Edge*, uint32_t> initCosts;
 
   std::set<trgraph::Edge*> eFrs, eTos;
@@ -578,7 +987,7 @@ void RouterImpl<TW>::hopsFast(const EdgeCandGroup& froms,
         }
 
         if (wrCost < maxCost - maxProgrStart) {
-          rCosts->push_back({{frId, toId}, wrCost});
+          rCosts->set(frId, toId, wrCost);
         }
       }
     }
@@ -623,6 +1032,36 @@ bool RouterImpl<TW>::cacheDrop(HopCache* hopCache,
   return true;
 }
 
+// _____________________________________________________________________________
+template <typename TW>
+size_t RouterImpl<TW>::beamPrune(const EdgeCandGroup& cands,
+                                 const LayerCostsDAG& costs, size_t width,
+                                 EdgeCandGroup* beam, double* cut) const {
+  *cut = DBL_INF;
+
+  std::vector<size_t> ids;
+  for (size_t i = 0; i < cands.size(); i++) {
+    if (cands[i].e) ids.push_back(i);
+  }
+
+  if (ids.size() <= width) return 0;
+
+  // break ties by position, to keep the beam deterministic
+  std::nth_element(ids.begin(), ids.begin() + width, ids.end(),
+                   [&costs](size_t a, size_t b) {
+                     return costs[a] < costs[b] ||
+                            (costs[a] == costs[b] && a < b);
+                   });
+
+  *beam = cands;
+  for (size_t k = width; k < ids.size(); k++) {
+    (*beam)[ids[k]].e = 0;
+    if (costs[ids[k]] < *cut) *cut = costs[ids[k]];
+  }
+
+  return ids.size() - width;
+}
+
 // _____________________________________________________________________________
 template <typename TW>
 uint32_t RouterImpl<TW>::addNonOverflow(uint32_t a, uint32_t b) const {
@@ -3,13 +3,14 @@
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
 #include <atomic>
+#include <cmath>
 #include <cstdlib>
+#include <deque>
 #include <limits>
 #include <map>
 #include <mutex>
 #include <random>
 #include <stdexcept>
-#include <thread>
 #include <unordered_map>
 #include <utility>
 
@@ -48,8 +49,6 @@ using pfaedle::router::ShapeBuilder;
 using pfaedle::router::Stats;
 using pfaedle::router::TripForests;
 using pfaedle::router::TripTrie;
-using pfaedle::trgraph::EdgeGrid;
-using pfaedle::trgraph::NodeGrid;
 using util::geo::latLngToWebMerc;
 using util::geo::M_PER_DEG;
 using util::geo::output::GeoGraphJsonOutput;
@@ -65,7 +64,7 @@ ShapeBuilder::ShapeBuilder(
     pfaedle::trgraph::Graph* g, router::FeedStops* fStops,
     osm::Restrictor* restr,
     const pfaedle::statsimiclassifier::StatsimiClassifier* classifier,
-    router::Router* router, const config::Config& cfg)
+    router::Router* router, const config::Config& cfg, ThreadPool* pool)
     : _feed(feed),
       _mots(mots),
       _motCfg(motCfg),
@@ -75,17 +74,8 @@ ShapeBuilder::ShapeBuilder(
       _curShpCnt(0),
       _restr(restr),
       _classifier(classifier),
-      _router(router) {
-  pfaedle::osm::BBoxIdx box(cfg.boxPadding);
-  ShapeBuilder::getGtfsBox(feed, mots, cfg.shapeTripId, cfg.dropShapes, &box,
-                           _motCfg.osmBuildOpts.maxSpeed, 0, cfg.verbosity);
-
-  _eGrid = EdgeGrid(cfg.gridSize, cfg.gridSize, box.getFullBox(), false);
-  _nGrid = NodeGrid(cfg.gridSize, cfg.gridSize, box.getFullBox(), false);
-
-  LOG(DEBUG) << "Grid size of " << _nGrid.getXWidth() << "x"
-             << _nGrid.getYHeight();
-
+      _router(router),
+      _pool(pool) {
   buildIndex();
 }
 
@@ -97,22 +87,29 @@ void ShapeBuilder::buildIndex() {
       // don't snap to one way edges
       if (e->pl().oneWay() == 2) continue;
 
-      _eGrid.add(*e->pl().getGeom(), e);
+      _eIdx.add(*e->pl().getGeom(), e);
     }
   }
 
   for (auto* n : _g->getNds()) {
     // only station nodes
     if (n->pl().getSI()) {
-      _nGrid.add(*n->pl().getGeom(), n);
+      _nIdx.add(*n->pl().getGeom(), n);
     }
   }
+
+  _eIdx.build();
+  _nIdx.build();
+
+  LOG(DEBUG) << "Candidate index holds " << _eIdx.size() << " edges and "
+             << _nIdx.size() << " station nodes, "
+             << (_eIdx.getMemSize() + _nIdx.getMemSize()) / (1024 * 1024)
+             << " MB";
 }
 
 // _____________________________________________________________________________
 void ShapeBuilder::buildCandCache(const TripForests& forests) {
   std::set<const Stop*> stops;
-  size_t count = 0;
 
   for (const auto& forest : forests) {
     for (const auto& trie : forest.second) {
@@ -124,44 +121,164 @@ void ShapeBuilder::buildCandCache(const TripForests& forests) {
     }
   }
 
-  size_t numThreads = std::thread::hardware_concurrency();
-  std::vector<std::thread> thrds(numThreads);
-  std::vector<GrpCache> caches(numThreads);
-  std::vector<std::vector<const Stop*>> threadStops(numThreads);
+  buildCandCache(stops);
+}
 
-  size_t i = 0;
+// _____________________________________________________________________________
+void ShapeBuilder::buildCandCache(const std::set<const Stop*>& stops) {
+  std::vector<const Stop*> todo;
   for (auto stop : stops) {
-    threadStops[i].push_back(stop);
-    if (++i == numThreads) i = 0;
+    if (!_grpCache.count(stop)) todo.push_back(stop);
   }
 
-  i = 0;
-  for (auto& t : thrds) {
-    t = std::thread(&ShapeBuilder::edgCandWorker, this, &threadStops[i],
-                    &caches[i]);
-    i++;
+  if (todo.empty()) return;
+
+  // sort the stops along a Hilbert curve, so that nearby stops end up in the
+  // same batch
+  double lx = std::numeric_limits<double>::max(), ly = lx;
+  double ux = std::numeric_limits<double>::lowest(), uy = ux;
+  for (auto stop : todo) {
+    lx = std::min<double>(lx, stop->getLng());
+    ly = std::min<double>(ly, stop->getLat());
+    ux = std::max<double>(ux, stop->getLng());
+    uy = std::max<double>(uy, stop->getLat());
   }
 
-  for (auto& thr : thrds) thr.join();
+  double cellW = std::max(ux - lx, 1e-9) / 65535;
+  double cellH = std::max(uy - ly, 1e-9) / 65535;
 
-  // merge
-  for (size_t i = 0; i < numThreads; i++) {
-    for (const auto& c : caches[i]) {
-      _grpCache[c.first] = c.second;
-      count += c.second.size();
+  std::vector<std::pair<uint64_t, const Stop*>> sorted;
+  sorted.reserve(todo.size());
+  for (auto stop : todo) {
+    uint32_t x = (stop->getLng() - lx) / cellW;
+    uint32_t y = (stop->getLat() - ly) / cellH;
+    sorted.push_back({hilbertIdx(x, y), stop});
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  // cut the curve into batches, a batch is closed if it is full or if its
+  // extent grows well beyond the search radius, which would make the
+  // shared index traversal pointless
+  const size_t MAX_BATCH_SIZE = 64;
+  double maxExt = 4 * std::max(std::sqrt(2) *
+                                   _motCfg.osmBuildOpts.maxStationCandDistance,
+                               _motCfg.osmBuildOpts.maxSnapDistance) /
+                  M_PER_DEG;
+
+  std::vector<const Stop*> batchStops;
+  std::vector<size_t> batchBegs;
+  double blx = 0, bly = 0, bux = 0, buy = 0;
+  for (const auto& st : sorted) {
+    double x = st.second->getLng(), y = st.second->getLat();
+    if (batchBegs.empty() ||
+        batchStops.size() - batchBegs.back() == MAX_BATCH_SIZE ||
+        std::max(bux, x) - std::min(blx, x) > maxExt ||
+        std::max(buy, y) - std::min(bly, y) > maxExt) {
+      batchBegs.push_back(batchStops.size());
+      blx = bux = x;
+      bly = buy = y;
     }
+
+    blx = std::min(blx, x);
+    bly = std::min(bly, y);
+    bux = std::max(bux, x);
+    buy = std::max(buy, y);
+    batchStops.push_back(st.second);
+  }
+  batchBegs.push_back(batchStops.size());
+
+  // each stop gets a fixed slot in the arena, the workers write their
+  // groups directly into it
+  size_t base = _grps.size();
+  _grps.resize(base + batchStops.size());
+
+  size_t numThreads = _pool->getNumThreads();
+  std::vector<size_t> numDists(numThreads, 0);
+  std::atomic<size_t> next(0);
+
+  _pool->run(numThreads, [&](size_t t) {
+    edgCandWorker(&batchStops, &batchBegs, base, &next, &numDists[t]);
+  });
+
+  size_t count = 0;
+  for (size_t i = 0; i < batchStops.size(); i++) {
+    _grpCache[batchStops[i]] = base + i;
+    count += _grps[base + i].size();
   }
 
-  if (_grpCache.size())
-    LOG(DEBUG) << "Average candidate set size: "
-               << ((count * 1.0) / _grpCache.size());
+  size_t totNumDists = 0;
+  for (auto n : numDists) totNumDists += n;
+
+  LOG(DEBUG) << "Searched candidates for " << batchStops.size()
+             << " stops in " << (batchBegs.size() - 1) << " batches with "
+             << totNumDists << " distance computations";
+
+  LOG(DEBUG) << "Average candidate set size: "
+             << ((count * 1.0) / batchStops.size());
 }
 
 // _____________________________________________________________________________
-EdgeCandGroup ShapeBuilder::getEdgCands(const Stop* s) const {
+const EdgeCandGroup& ShapeBuilder::getEdgCands(const Stop* s) const {
   auto cached = _grpCache.find(s);
-  if (cached != _grpCache.end()) return cached->second;
+  if (cached == _grpCache.end()) {
+    throw std::runtime_error("No edge candidates cached for stop '" +
+                             s->getName() + "'");
+  }
+  return _grps[cached->second];
+}
+
+// _____________________________________________________________________________
+void ShapeBuilder::getEdgCands(const std::vector<const Stop*>& stops,
+                               std::vector<EdgeCandGroup>* rets,
+                               size_t* numDists) const {
+  std::vector<POINT> poss(stops.size());
+  std::vector<double> ndRads(stops.size()), edgRads(stops.size());
+
+  for (size_t i = 0; i < stops.size(); i++) {
+    auto pos = POINT(stops[i]->getLng(), stops[i]->getLat());
+    double distor = util::geo::latLngDistFactor(pos);
+
+    if (_cfg.gaussianNoise > 0) {
+      unsigned seed =
+          std::chrono::system_clock::now().time_since_epoch().count();
+      std::default_random_engine gen(seed);
+
+      // the standard dev is given in meters, convert (roughly...) to degrees
+      double standardDev = (_cfg.gaussianNoise / M_PER_DEG) / distor;
+
+      // mean 0 (no movement), standard dev according to config
+      std::normal_distribution<double> dist(0.0, standardDev);
+
+      // add gaussian noise
+      pos.setX(pos.getX() + dist(gen));
+      pos.setY(pos.getY() + dist(gen));
+    }
 
+    poss[i] = pos;
+
+    // the radius covers the padded bounding box previously used for
+    // stations, the exact distance is checked in buildEdgCands()
+    ndRads[i] = std::sqrt(2) *
+                (_motCfg.osmBuildOpts.maxStationCandDistance / M_PER_DEG) /
+                distor;
+    edgRads[i] = (_motCfg.osmBuildOpts.maxSnapDistance / M_PER_DEG) / distor;
+  }
+
+  std::vector<NdHits> ndHits;
+  std::vector<EdgHits> edgHits;
+  *numDists += _nIdx.get(poss, ndRads, &ndHits);
+  *numDists += _eIdx.get(poss, edgRads, &edgHits);
+
+  rets->resize(stops.size());
+  for (size_t i = 0; i < stops.size(); i++) {
+    (*rets)[i] = buildEdgCands(stops[i], poss[i], ndHits[i], edgHits[i]);
+  }
+}
+
+// _____________________________________________________________________________
+EdgeCandGroup ShapeBuilder::buildEdgCands(const Stop* s, const POINT& pos,
+                                          const NdHits& ndHits,
+                                          const EdgHits& edgHits) const {
   EdgeCandGroup ret;
 
   const auto& snormzer = _motCfg.osmBuildOpts.statNormzer;
@@ -169,38 +286,19 @@ EdgeCandGroup ShapeBuilder::getEdgCands(const Stop* s) const {
 
   // the first cand is a placeholder for the stop position itself, it is chosen
   // when no candidate yielded a feasible route
-  auto pos = POINT(s->getLng(), s->getLat());
-  ret.push_back({0, 0, 0, pos, 0, {}});
-  
-  LOG(VDEBUG) << "Getting edge candidates for stop '" << s->getName() 
+  auto stopPos = POINT(s->getLng(), s->getLat());
+  ret.push_back({0, 0, 0, stopPos, 0, {}});
+
+  LOG(VDEBUG) << "Getting edge candidates for stop '" << s->getName()
               << "' at (" << s->getLat() << ", " << s->getLng() << ")";
 
   double maxMDist = _motCfg.osmBuildOpts.maxStationCandDistance;
 
-  double distor = util::geo::latLngDistFactor(pos);
-
-  if (_cfg.gaussianNoise > 0) {
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::default_random_engine gen(seed);
-
-    // the standard dev is given in meters, convert (roughly...) to degrees
-    double standardDev = (_cfg.gaussianNoise / M_PER_DEG) / distor;
-
-    // mean 0 (no movement), standard dev according to config
-    std::normal_distribution<double> dist(0.0, standardDev);
-
-    // add gaussian noise
-    pos.setX(pos.getX() + dist(gen));
-    pos.setY(pos.getY() + dist(gen));
-  }
-
-  std::set<trgraph::Node*> frNIdx;
-  _nGrid.get(util::geo::pad(util::geo::getBoundingBox(pos),
-                            (maxMDist / M_PER_DEG) / distor),
-             &frNIdx);
+  double distor = util::geo::latLngDistFactor(stopPos);
 
   if (_motCfg.routingOpts.useStations) {
-    for (auto nd : frNIdx) {
+    for (const auto& ndCand : ndHits) {
+      auto nd = ndCand.first;
       assert(nd->pl().getSI());
 
       double mDist = util::geo::haversine(pos, *nd->pl().getGeom());
@@ -236,21 +334,18 @@ EdgeCandGroup ShapeBuilder::getEdgCands(const Stop* s) const {
 
   maxMDist = _motCfg.osmBuildOpts.maxSnapDistance;
 
-  std::set<trgraph::Edge*> frEIdx;
-  _eGrid.get(util::geo::pad(util::geo::getBoundingBox(pos),
-                            (maxMDist / M_PER_DEG) / distor),
-             &frEIdx);
-
   std::set<trgraph::Edge*> selected;
   std::map<const trgraph::Edge*, double> scores;
   std::map<const trgraph::Edge*, double> progrs;
 
-  for (auto edg : frEIdx) {
+  // edges within maxMDist, nearest first
+  for (const auto& edgCand : edgHits) {
+    auto edg = edgCand.first;
     if (selected.count(edg)) continue;
 
     auto reach = deg2reachable(edg, selected);
 
-    double mDist = dist(pos, *edg->pl().getGeom()) * distor * M_PER_DEG;
+    double mDist = edgCand.second * distor * M_PER_DEG;
 
     if (mDist > maxMDist) continue;
 
@@ -324,12 +419,17 @@ std::pair<std::vector<LINE>, Stats> ShapeBuilder::shapeL(Trip* trip) {
   try {
     T_START(t);
     EDijkstra::ITERS = 0;
+    CSRDijkstra::ITERS = 0;
+    ContractionHierarchy::ITERS = 0;
     auto hops = shapeify(trip);
     stats.solveTime = T_STOP(t);
     stats.numTries = 1;
     stats.numTrieLeafs = 1;
     stats.totNumTrips = 1;
-    stats.dijkstraIters = EDijkstra::ITERS;
+    stats.dijkstraIters =
+        EDijkstra::ITERS + CSRDijkstra::ITERS + ContractionHierarchy::ITERS;
+    stats.beamPruned = _router->getNumBeamPruned();
+    stats.beamUncertain = _router->getNumBeamUncertain();
     std::map<uint32_t, double> colors;
     LOG(INFO) << "Matched 1 trip in " << std::fixed << std::setprecision(2)
               << stats.solveTime << " ms.";
@@ -346,7 +446,8 @@ std::map<size_t, pfaedle::router::EdgeListHops> ShapeBuilder::route(
     const TripTrie<pfaedle::gtfs::Trip>* trie, const EdgeCandMap& ecm,
     HopCache* hopCache) const {
   return _router->route(trie, ecm, _motCfg.routingOpts, *_restr, hopCache,
-                        _cfg.noFastHops);
+                        _cfg.noFastHops, _cfg.parallelHops, _cfg.beamWidth,
+                        _pool);
 }
 
 // _____________________________________________________________________________
@@ -380,6 +481,11 @@ EdgeListHops ShapeBuilder::shapeify(Trip* trip) {
   TripTrie<pfaedle::gtfs::Trip> trie;
   trie.addTrip(trip, getRAttrs(trip),
                _motCfg.routingOpts.transPenMethod == "timenorm", false);
+
+  std::set<const Stop*> stops;
+  for (const auto& st : trip->getStopTimes()) stops.insert(st.getStop());
+  buildCandCache(stops);
+
   const auto& routes = route(&trie, getECM(&trie), 0);
 
   return routes.begin()->second;
@@ -389,6 +495,8 @@ EdgeListHops ShapeBuilder::shapeify(Trip* trip) {
 Stats ShapeBuilder::shapeify(pfaedle::netgraph::Graph* outNg) {
   Stats stats;
   EDijkstra::ITERS = 0;
+  CSRDijkstra::ITERS = 0;
+  ContractionHierarchy::ITERS = 0;
 
   T_START(cluster);
   LOG(DEBUG) << "Clustering trips...";
@@ -424,13 +532,22 @@ Stats ShapeBuilder::shapeify(pfaedle::netgraph::Graph* outNg) {
     }
   }
 
-  // we implicitely cluster by routing attrs here. This ensures that now two
-  // threads will access the same routing attrs later on, which safes us an
-  // expensive locking mechanism later on for the hop cache
-  std::vector<const TripForest*> tries;
+  // we implicitely cluster by routing attrs here. Each forest gets its own
+  // hop cache for the attribute-dependent hops, all other hops go into the
+  // shared hop cache
+  std::deque<HopCache> hopCaches;
+  std::vector<TrieJob> tries;
+  std::vector<double> trieCosts;
   for (const auto& forest : forests) {
-    tries.push_back(&(forest.second));
+    HopCache* hopCache = 0;
+    if (!_cfg.noHopCache) {
+      hopCaches.emplace_back(&_sharedHopCache);
+      hopCache = &hopCaches.back();
+    }
+
     for (const auto& trie : forest.second) {
+      tries.push_back({&trie, hopCache});
+      trieCosts.push_back(estimCost(trie));
       for (const auto& trips : trie.getNdTrips()) {
         stats.totNumTrips += trips.second.size();
       }
@@ -440,19 +557,28 @@ Stats ShapeBuilder::shapeify(pfaedle::netgraph::Graph* outNg) {
   auto tStart = TIME();
   std::atomic<size_t> at(0);
 
-  size_t numThreads = std::thread::hardware_concurrency();
-  std::vector<std::thread> thrds(numThreads);
+  size_t numThreads = _pool->getNumThreads();
+  TrieScheduler sched(trieCosts, numThreads);
   std::vector<RouteRefColors> colors(numThreads);
   std::vector<TrGraphEdgs> gtfsGraphs(numThreads);
 
-  size_t i = 0;
-  for (auto& t : thrds) {
-    t = std::thread(&ShapeBuilder::shapeWorker, this, &tries, &at, &shpUse,
-                    &colors[i], &gtfsGraphs[i]);
-    i++;
-  }
+  _pool->run(numThreads, [&](size_t i) {
+    shapeWorker(&tries, &sched, i, &at, &shpUse, &colors[i], &gtfsGraphs[i]);
+  });
 
-  for (auto& thr : thrds) thr.join();
+  LOG(DEBUG) << sched.getNumStolen() << " of " << tries.size()
+             << " tries were stolen by idle threads";
+
+  for (const auto& hopCache : hopCaches) {
+    stats.hopCacheLookups += hopCache.getNumLookups();
+    stats.hopCacheHits += hopCache.getNumHits();
+    stats.hopCacheContended += hopCache.getNumContended();
+  }
+  stats.sharedHopCacheLookups = _sharedHopCache.getNumLookups();
+  stats.sharedHopCacheHits = _sharedHopCache.getNumHits();
+  stats.hopCacheContended += _sharedHopCache.getNumContended();
+  stats.beamPruned = _router->getNumBeamPruned();
+  stats.beamUncertain = _router->getNumBeamUncertain();
 
   stats.solveTime = TOOK_UNTIL(tStart, TIME());
 
@@ -488,7 +614,8 @@ Stats ShapeBuilder::shapeify(pfaedle::netgraph::Graph* outNg) {
     buildNetGraph(&gtfsGraph, outNg);
   }
 
-  stats.dijkstraIters = EDijkstra::ITERS;
+  stats.dijkstraIters =
+      EDijkstra::ITERS + CSRDijkstra::ITERS + ContractionHierarchy::ITERS;
 
   return stats;
 }
@@ -886,8 +1013,7 @@ TripForests ShapeBuilder::clusterTrips(Feed* f, MOTs mots) {
     forest[rAttrs] = {};
   }
 
-  size_t numThreads = std::thread::hardware_concurrency();
-  std::vector<std::thread> thrds(numThreads);
+  size_t numThreads = _pool->getNumThreads();
   std::vector<std::vector<RoutingAttrs>> attrs(numThreads);
 
   size_t i = 0;
@@ -896,14 +1022,9 @@ TripForests ShapeBuilder::clusterTrips(Feed* f, MOTs mots) {
     if (++i == numThreads) i = 0;
   }
 
-  i = 0;
-  for (auto& t : thrds) {
-    t = std::thread(&ShapeBuilder::clusterWorker, this, &attrs[i], &trips,
-                    &forest);
-    i++;
-  }
-
-  for (auto& thr : thrds) thr.join();
+  _pool->run(numThreads, [&](size_t t) {
+    clusterWorker(&attrs[t], &trips, &forest);
+  });
 
   return forest;
 }
@@ -1166,78 +1287,104 @@ std::vector<float> ShapeBuilder::getMeasure(
 
 // _____________________________________________________________________________
 void ShapeBuilder::shapeWorker(
-    const std::vector<const TripForest*>* tries, std::atomic<size_t>* at,
-    std::map<std::string, size_t>* shpUse,
+    const std::vector<TrieJob>* tries, TrieScheduler* sched, size_t thrd,
+    std::atomic<size_t>* at, std::map<std::string, size_t>* shpUse,
     std::map<Route*, std::map<uint32_t, std::vector<gtfs::Trip*>>>* routeColors,
     TrGraphEdgs* gtfsGraph) {
-  while (1) {
+  size_t k;
+  while (sched->next(thrd, &k)) {
     size_t j = (*at)++;
-    if (j >= tries->size()) return;
 
     int step = tries->size() < 10 ? tries->size() : 10;
 
     if (j % (tries->size() / step) == 0) {
       LOG(INFO) << "@ " << (static_cast<int>((j * 1.0) / tries->size() * 100))
                 << "%";
-      LOG(DEBUG) << "(@ trie forest " << j << "/" << tries->size() << ")";
+      LOG(DEBUG) << "(@ trie " << j << "/" << tries->size() << ")";
     }
 
-    const auto& forest = *((*tries)[j]);
+    const TripTrie<pfaedle::gtfs::Trip>* trie = (*tries)[k].trie;
 
     // hop cache per forest, thus per routing attributes
-    HopCache hopCacheLoc;
-    HopCache* hopCache = 0;
+    HopCache* hopCache = (*tries)[k].hopCache;
 
-    if (!_cfg.noHopCache) hopCache = &hopCacheLoc;
+    const auto& hops = shapeify(trie, hopCache);
 
-    for (size_t i = 0; i < forest.size(); i++) {
-      const TripTrie<pfaedle::gtfs::Trip>* trie = &(forest[i]);
-      const auto& hops = shapeify(trie, hopCache);
+    for (const auto& leaf : trie->getNdTrips()) {
+      std::vector<float> distances;
+      const RoutingAttrs& rAttrs = trie->getNd(leaf.first).rAttrs;
 
-      for (const auto& leaf : trie->getNdTrips()) {
-        std::vector<float> distances;
-        const RoutingAttrs& rAttrs = trie->getNd(leaf.first).rAttrs;
+      uint32_t color;
 
-        uint32_t color;
+      const ad::cppgtfs::gtfs::Shape& shp =
+          getGtfsShape(hops.at(leaf.first), leaf.second[0],
+                       leaf.second.size(), rAttrs, &distances, &color);
 
-        const ad::cppgtfs::gtfs::Shape& shp =
-            getGtfsShape(hops.at(leaf.first), leaf.second[0],
-                         leaf.second.size(), rAttrs, &distances, &color);
+      if (_cfg.buildTransitGraph) {
+        writeTransitGraph(hops.at(leaf.first), gtfsGraph, leaf.second);
+      }
 
-        if (_cfg.buildTransitGraph) {
-          writeTransitGraph(hops.at(leaf.first), gtfsGraph, leaf.second);
+      for (auto t : leaf.second) {
+        if (_cfg.writeColors && color != NO_COLOR &&
+            t->getRoute()->getColor() == NO_COLOR &&
+            t->getRoute()->getTextColor() == NO_COLOR) {
+          (*routeColors)[t->getRoute()][color].push_back(t);
+        } else {
+          // else, use the original route color
+          (*routeColors)[t->getRoute()][t->getRoute()->getColor()].push_back(
+              t);
         }
 
-        for (auto t : leaf.second) {
-          if (_cfg.writeColors && color != NO_COLOR &&
-              t->getRoute()->getColor() == NO_COLOR &&
-              t->getRoute()->getTextColor() == NO_COLOR) {
-            (*routeColors)[t->getRoute()][color].push_back(t);
-          } else {
-            // else, use the original route color
-            (*routeColors)[t->getRoute()][t->getRoute()->getColor()].push_back(
-                t);
-          }
-
-          if (!t->getShape().empty() && (*shpUse)[t->getShape()] > 0) {
+        // tries sharing a shape may be matched concurrently
+        if (!t->getShape().empty()) {
+          std::lock_guard<std::mutex> guard(_shpMutex);
+          if ((*shpUse)[t->getShape()] > 0) {
             (*shpUse)[t->getShape()]--;
             if ((*shpUse)[t->getShape()] == 0) {
-              std::lock_guard<std::mutex> guard(_shpMutex);
               _feed->getShapes().remove(t->getShape());
             }
           }
-          setShape(t, shp, distances);
         }
+        setShape(t, shp, distances);
       }
     }
   }
 }
 
 // _____________________________________________________________________________
-void ShapeBuilder::edgCandWorker(std::vector<const Stop*>* stops,
-                                 GrpCache* cache) {
-  for (auto stop : *stops) {
-    (*cache)[stop] = getEdgCands(stop);
+double ShapeBuilder::estimCost(
+    const TripTrie<pfaedle::gtfs::Trip>& trie) const {
+  // number of trie nodes times the average candidate group size
+  double cands = 0;
+  size_t n = 0;
+  for (size_t nid = 1; nid < trie.getNds().size(); nid++) {
+    auto grp = _grpCache.find(trie.getNd(nid).reprStop);
+    if (grp == _grpCache.end()) continue;
+    cands += _grps[grp->second].size();
+    n++;
+  }
+
+  if (n == 0) return trie.getNds().size();
+  return trie.getNds().size() * (cands / n);
+}
+
+// _____________________________________________________________________________
+void ShapeBuilder::edgCandWorker(const std::vector<const Stop*>* stops,
+                                 const std::vector<size_t>* batchBegs,
+                                 size_t base, std::atomic<size_t>* next,
+                                 size_t* numDists) {
+  std::vector<const Stop*> batch;
+  std::vector<EdgeCandGroup> grps;
+  size_t i;
+  while ((i = (*next)++) + 1 < batchBegs->size()) {
+    size_t beg = (*batchBegs)[i];
+    batch.assign(stops->begin() + beg, stops->begin() + (*batchBegs)[i + 1]);
+    getEdgCands(batch, &grps, numDists);
+
+    // the slots are disjoint, no locking needed
+    for (size_t j = 0; j < batch.size(); j++) {
+      _grps[base + beg + j] = std::move(grps[j]);
+    }
   }
 }
 
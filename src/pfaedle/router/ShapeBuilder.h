@@ -5,6 +5,7 @@
 #ifndef PFAEDLE_ROUTER_SHAPEBUILDER_H_
 #define PFAEDLE_ROUTER_SHAPEBUILDER_H_
 
+#include <deque>
 #include <map>
 #include <mutex>
 #include <set>
@@ -15,14 +16,17 @@
 
 #include "ad/cppgtfs/gtfs/Feed.h"
 #include "pfaedle/Def.h"
+#include "pfaedle/ThreadPool.h"
 #include "pfaedle/config/MotConfig.h"
 #include "pfaedle/config/PfaedleConfig.h"
 #include "pfaedle/gtfs/Feed.h"
 #include "pfaedle/netgraph/Graph.h"
 #include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/CandIdx.h"
 #include "pfaedle/router/Misc.h"
 #include "pfaedle/router/Router.h"
 #include "pfaedle/router/Stats.h"
+#include "pfaedle/router/TrieScheduler.h"
 #include "pfaedle/router/TripTrie.h"
 #include "pfaedle/statsimi-classifier/StatsimiClassifier.h"
 #include "pfaedle/trgraph/Graph.h"
@@ -43,8 +47,16 @@ typedef std::unordered_map<const trgraph::Edge*,
     TrGraphEdgs;
 typedef std::map<Route*, std::map<uint32_t, std::vector<gtfs::Trip*>>>
     RouteRefColors;
-typedef std::unordered_map<const ad::cppgtfs::gtfs::Stop*, EdgeCandGroup>
-    GrpCache;
+// position of the candidate group of a stop in the group arena
+typedef std::unordered_map<const ad::cppgtfs::gtfs::Stop*, size_t> GrpCache;
+typedef std::vector<std::pair<trgraph::Node*, double>> NdHits;
+typedef std::vector<std::pair<trgraph::Edge*, double>> EdgHits;
+
+// a single trie to be map-matched, with the hop cache of its forest
+struct TrieJob {
+  const TripTrie<pfaedle::gtfs::Trip>* trie;
+  HopCache* hopCache;
+};
 
 /*
  * Layer class for the router. Provides an interface for direct usage with
@@ -56,7 +68,7 @@ class ShapeBuilder {
       pfaedle::gtfs::Feed* feed, MOTs mots, const config::MotConfig& motCfg,
       trgraph::Graph* g, router::FeedStops* stops, osm::Restrictor* restr,
       const pfaedle::statsimiclassifier::StatsimiClassifier* classifier,
-      router::Router* router, const config::Config& cfg);
+      router::Router* router, const config::Config& cfg, ThreadPool* pool);
 
   Stats shapeify(pfaedle::netgraph::Graph* outNg);
 
@@ -95,9 +107,17 @@ class ShapeBuilder {
   osm::Restrictor* _restr;
   const pfaedle::statsimiclassifier::StatsimiClassifier* _classifier;
   GrpCache _grpCache;
+  // the candidate groups, a deque keeps references to them stable when
+  // groups are added
+  std::deque<EdgeCandGroup> _grps;
 
   router::Router* _router;
 
+  ThreadPool* _pool;
+
+  // hops independent of the routing attributes, shared by all forests
+  router::HopCache _sharedHopCache;
+
   TripForests clusterTrips(pfaedle::gtfs::Feed* f, MOTs mots);
   void buildNetGraph(TrGraphEdgs* edgs, pfaedle::netgraph::Graph* ng) const;
 
@@ -112,7 +132,16 @@ class ShapeBuilder {
   void setShape(pfaedle::gtfs::Trip* t, const ad::cppgtfs::gtfs::Shape& s,
                 const std::vector<float>& dists);
 
-  EdgeCandGroup getEdgCands(const ad::cppgtfs::gtfs::Stop* s) const;
+  // The cached candidates of s, throws if they have not been cached by
+  // buildCandCache()
+  const EdgeCandGroup& getEdgCands(const ad::cppgtfs::gtfs::Stop* s) const;
+  // Get the candidates for a batch of nearby stops, which share a single
+  // index lookup
+  void getEdgCands(const std::vector<const Stop*>& stops,
+                   std::vector<EdgeCandGroup>* rets, size_t* numDists) const;
+  EdgeCandGroup buildEdgCands(const Stop* s, const POINT& pos,
+                              const NdHits& ndHits,
+                              const EdgHits& edgHits) const;
 
   router::EdgeCandMap getECM(const TripTrie<pfaedle::gtfs::Trip>* trie) const;
   std::vector<double> getTransTimes(pfaedle::gtfs::Trip* trip) const;
@@ -125,6 +154,7 @@ class ShapeBuilder {
   double emWeight(double mDist) const;
 
   void buildCandCache(const TripForests& clusters);
+  void buildCandCache(const std::set<const Stop*>& stops);
   void buildIndex();
 
   std::vector<LINE> getGeom(const EdgeListHops& shp, const RoutingAttrs& rAttrs,
@@ -153,18 +183,24 @@ class ShapeBuilder {
                          const std::vector<pfaedle::gtfs::Trip*>& trips) const;
 
   void shapeWorker(
-      const std::vector<const TripForest*>* tries, std::atomic<size_t>* at,
-      std::map<std::string, size_t>* shpUsage,
+      const std::vector<TrieJob>* tries, TrieScheduler* sched, size_t thrd,
+      std::atomic<size_t>* at, std::map<std::string, size_t>* shpUsage,
       std::map<Route*, std::map<uint32_t, std::vector<gtfs::Trip*>>>*,
       TrGraphEdgs* gtfsGraph);
 
-  void edgCandWorker(std::vector<const Stop*>* stops, GrpCache* cache);
+  // Estimate the cost of map-matching trie, used to schedule the
+  // expensive tries first
+  double estimCost(const TripTrie<pfaedle::gtfs::Trip>& trie) const;
+
+  void edgCandWorker(const std::vector<const Stop*>* stops,
+                     const std::vector<size_t>* batchBegs, size_t base,
+                     std::atomic<size_t>* next, size_t* numDists);
   void clusterWorker(const std::vector<RoutingAttrs>* rAttrs,
                      const std::map<RoutingAttrs, std::vector<Trip*>>* trips,
                      TripForests* forest);
 
-  pfaedle::trgraph::EdgeGrid _eGrid;
-  pfaedle::trgraph::NodeGrid _nGrid;
+  CandIdx<trgraph::Edge*> _eIdx;
+  CandIdx<trgraph::Node*> _nIdx;
 };
 
 }  // namespace router
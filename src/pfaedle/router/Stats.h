@@ -19,12 +19,26 @@ struct Stats {
         numTries(0),
         numTrieLeafs(0),
         solveTime(0),
-        dijkstraIters(0) {}
+        dijkstraIters(0),
+        hopCacheLookups(0),
+        hopCacheHits(0),
+        sharedHopCacheLookups(0),
+        sharedHopCacheHits(0),
+        hopCacheContended(0),
+        beamPruned(0),
+        beamUncertain(0) {}
   size_t totNumTrips;
   size_t numTries;
   size_t numTrieLeafs;
   double solveTime;
   size_t dijkstraIters;
+  size_t hopCacheLookups;
+  size_t hopCacheHits;
+  size_t sharedHopCacheLookups;
+  size_t sharedHopCacheHits;
+  size_t hopCacheContended;
+  size_t beamPruned;
+  size_t beamUncertain;
 };
 
 inline Stats operator+ (const Stats& c1, const Stats& c2) {
@@ -34,6 +48,13 @@ inline Stats operator+ (const Stats& c1, const Stats& c2) {
   ret.numTrieLeafs += c2.numTrieLeafs;
   ret.solveTime += c2.solveTime;
   ret.dijkstraIters += c2.dijkstraIters;
+  ret.hopCacheLookups += c2.hopCacheLookups;
+  ret.hopCacheHits += c2.hopCacheHits;
+  ret.sharedHopCacheLookups += c2.sharedHopCacheLookups;
+  ret.sharedHopCacheHits += c2.sharedHopCacheHits;
+  ret.hopCacheContended += c2.hopCacheContended;
+  ret.beamPruned += c2.beamPruned;
+  ret.beamUncertain += c2.beamUncertain;
   return ret;
 }
 
@@ -0,0 +1,52 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <vector>
+#include "pfaedle/router/TrieScheduler.h"
+
+using pfaedle::router::TrieScheduler;
+
+// _____________________________________________________________________________
+TrieScheduler::TrieScheduler(const std::vector<double>& costs,
+                             size_t numThreads)
+    : _queues(numThreads ? numThreads : 1), _stolen(0) {
+  std::vector<size_t> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+    return costs[a] > costs[b];
+  });
+
+  std::vector<double> load(_queues.size(), 0);
+
+  for (size_t job : order) {
+    size_t q = std::min_element(load.begin(), load.end()) - load.begin();
+    _queues[q].jobs.push_back(job);
+    load[q] += costs[job];
+  }
+}
+
+// _____________________________________________________________________________
+bool TrieScheduler::next(size_t thrd, size_t* job) {
+  if (pop(thrd % _queues.size(), job)) return true;
+
+  for (size_t i = 1; i < _queues.size(); i++) {
+    if (pop((thrd + i) % _queues.size(), job)) {
+      _stolen++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// _____________________________________________________________________________
+bool TrieScheduler::pop(size_t queue, size_t* job) {
+  std::lock_guard<std::mutex> guard(_queues[queue].m);
+  if (_queues[queue].jobs.empty()) return false;
+  *job = _queues[queue].jobs.front();
+  _queues[queue].jobs.pop_front();
+  return true;
+}
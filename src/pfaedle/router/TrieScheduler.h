@@ -0,0 +1,47 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_ROUTER_TRIESCHEDULER_H_
+#define PFAEDLE_ROUTER_TRIESCHEDULER_H_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace pfaedle {
+namespace router {
+
+/*
+ * Work-stealing scheduler for independent jobs with estimated costs. The
+ * jobs are dealt longest-first onto one queue per thread, always onto the
+ * queue with the lowest total estimate. A thread takes the most expensive
+ * job left in its own queue; if that is empty, it steals the most expensive
+ * job left in the queue of another thread.
+ */
+class TrieScheduler {
+ public:
+  TrieScheduler(const std::vector<double>& costs, size_t numThreads);
+
+  // Write the next job for thread thrd to job. Return false if there are no
+  // jobs left
+  bool next(size_t thrd, size_t* job);
+
+  size_t getNumStolen() const { return _stolen; }
+
+ private:
+  struct Queue {
+    std::mutex m;
+    std::deque<size_t> jobs;
+  };
+
+  std::vector<Queue> _queues;
+  std::atomic<size_t> _stolen;
+
+  bool pop(size_t queue, size_t* job);
+};
+
+}  // namespace router
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_ROUTER_TRIESCHEDULER_H_
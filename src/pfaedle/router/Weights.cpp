@@ -61,94 +61,153 @@ uint32_t ExpoTransWeight::DistHeur::operator()(
   return heur;
 }
 
+// _____________________________________________________________________________
+uint32_t ExpoTransWeight::DistHeur::operator()(const trgraph::CSRGraph& g,
+                                               uint32_t a) const {
+  const double d = haversine(g.getGeom(g.getFrom(a)), _center);
+  const double heur = fmax(0, (d / _maxV - _maxCentD) * 10);
+
+  // avoid overflow
+  if (heur > std::numeric_limits<uint32_t>::max())
+    return std::numeric_limits<uint32_t>::max();
+
+  return heur;
+}
+
 // _____________________________________________________________________________
 uint32_t ExpoTransWeight::CostFunc::operator()(const trgraph::Edge* from,
                                                const trgraph::Node* n,
                                                const trgraph::Edge* to) const {
   if (!from) return 0;
 
-  uint32_t c = from->pl().getCost();
+  uint32_t c = lineCost(from, from->pl().getCost());
 
   if (c == std::numeric_limits<uint32_t>::max()) return c;
 
+  if (n && !n->pl().isTurnCycle()) {
+    // only intersection angles will be punished if the turn is non-trivial
+    bool fullTurn = _rOpts.fullTurnPunishFac != 0 &&
+                    ((from->getFrom() == to->getTo() &&
+                      from->getTo() == to->getFrom()) ||
+                     (n->getDeg() > 2 &&
+                      util::geo::innerProd(*n->pl().getGeom(),
+                                           from->pl().backHop(),
+                                           to->pl().frontHop()) <
+                          _rOpts.fullTurnAngle));
+
+    bool restr = _rOpts.turnRestrCost > 0 && from->pl().isRestricted() &&
+                 !_res.may(from, to, n);
+
+    c = turnCost(c, fullTurn, restr);
+  }
+
+  return c;
+}
+
+// _____________________________________________________________________________
+uint32_t ExpoTransWeight::CostFunc::operator()(const trgraph::CSRGraph& g,
+                                               uint32_t from,
+                                               uint32_t to) const {
+  uint32_t c = g.getCost(from);
+
+  if (c == std::numeric_limits<uint32_t>::max()) return c;
+
+  // the transit lines are only looked up if they may change the costs
+  if (!_noLineSimiPen) c = lineCost(g.getEdg(from), c);
+
+  if (c == std::numeric_limits<uint32_t>::max()) return c;
+
+  const uint32_t n = g.getTo(from);
+
+  if (!g.isTurnCycle(n)) {
+    bool fullTurn =
+        _rOpts.fullTurnPunishFac != 0 &&
+        ((g.getFrom(from) == g.getTo(to) && n == g.getFrom(to)) ||
+         (g.getDeg(n) > 2 &&
+          util::geo::innerProd(g.getGeom(n), g.backHop(from),
+                               g.frontHop(to)) < _rOpts.fullTurnAngle));
+
+    bool restr = _rOpts.turnRestrCost > 0 && g.isRestricted(from) &&
+                 !_res.may(g.getEdg(from), g.getEdg(to), g.getNd(n));
+
+    c = turnCost(c, fullTurn, restr);
+  }
+
+  return c;
+}
+
+// _____________________________________________________________________________
+uint32_t ExpoTransWeight::CostFunc::lineCost(const trgraph::Edge* from,
+                                             uint32_t c) const {
   if (from == _lastFrom) {
     // the transit line simi calculation is independent of the "to" edge, so if
     // the last "from" edge was the same, skip it!
-    c = _lastC;
-  } else if (!_noLineSimiPen) {
-    const auto& simi = transitLineSimi(from);
-
-    if (!simi.nameSimilar) {
-      if (_rOpts.lineUnmatchedPunishFact < 1) {
-        c = std::ceil(static_cast<double>(c) * _rOpts.lineUnmatchedPunishFact);
-      } else if (_rOpts.lineUnmatchedPunishFact > 1) {
-        double a =
-            std::round(static_cast<double>(c) * _rOpts.lineUnmatchedPunishFact);
-        if (a > std::numeric_limits<uint32_t>::max())
-          return std::numeric_limits<uint32_t>::max();
-        c = a;
-      }
-    }
+    return _lastC;
+  }
 
-    if (!simi.fromSimilar) {
-      if (_rOpts.lineNameFromUnmatchedPunishFact < 1) {
-        c = std::ceil(static_cast<double>(c) *
-                      _rOpts.lineNameFromUnmatchedPunishFact);
-      } else if (_rOpts.lineNameFromUnmatchedPunishFact > 1) {
-        double a = std::round(static_cast<double>(c) *
-                              _rOpts.lineNameFromUnmatchedPunishFact);
-        if (a > std::numeric_limits<uint32_t>::max())
-          return std::numeric_limits<uint32_t>::max();
-        c = a;
-      }
+  if (_noLineSimiPen) return c;
+
+  const auto& simi = transitLineSimi(from);
+
+  if (!simi.nameSimilar) {
+    if (_rOpts.lineUnmatchedPunishFact < 1) {
+      c = std::ceil(static_cast<double>(c) * _rOpts.lineUnmatchedPunishFact);
+    } else if (_rOpts.lineUnmatchedPunishFact > 1) {
+      double a =
+          std::round(static_cast<double>(c) * _rOpts.lineUnmatchedPunishFact);
+      if (a > std::numeric_limits<uint32_t>::max())
+        return std::numeric_limits<uint32_t>::max();
+      c = a;
     }
+  }
 
-    if (!simi.toSimilar) {
-      if (_rOpts.lineNameToUnmatchedPunishFact < 1) {
-        c = std::ceil(static_cast<double>(c) *
-                      _rOpts.lineNameToUnmatchedPunishFact);
-      } else if (_rOpts.lineNameToUnmatchedPunishFact > 1) {
-        double a = std::round(static_cast<double>(c) *
-                              _rOpts.lineNameToUnmatchedPunishFact);
-        if (a > std::numeric_limits<uint32_t>::max())
-          return std::numeric_limits<uint32_t>::max();
-        c = a;
-      }
+  if (!simi.fromSimilar) {
+    if (_rOpts.lineNameFromUnmatchedPunishFact < 1) {
+      c = std::ceil(static_cast<double>(c) *
+                    _rOpts.lineNameFromUnmatchedPunishFact);
+    } else if (_rOpts.lineNameFromUnmatchedPunishFact > 1) {
+      double a = std::round(static_cast<double>(c) *
+                            _rOpts.lineNameFromUnmatchedPunishFact);
+      if (a > std::numeric_limits<uint32_t>::max())
+        return std::numeric_limits<uint32_t>::max();
+      c = a;
     }
+  }
 
-    _lastC = c;
-    _lastFrom = from;
+  if (!simi.toSimilar) {
+    if (_rOpts.lineNameToUnmatchedPunishFact < 1) {
+      c = std::ceil(static_cast<double>(c) *
+                    _rOpts.lineNameToUnmatchedPunishFact);
+    } else if (_rOpts.lineNameToUnmatchedPunishFact > 1) {
+      double a = std::round(static_cast<double>(c) *
+                            _rOpts.lineNameToUnmatchedPunishFact);
+      if (a > std::numeric_limits<uint32_t>::max())
+        return std::numeric_limits<uint32_t>::max();
+      c = a;
+    }
   }
 
+  _lastC = c;
+  _lastFrom = from;
+
+  return c;
+}
+
+// _____________________________________________________________________________
+uint32_t ExpoTransWeight::CostFunc::turnCost(uint32_t c, bool fullTurn,
+                                             bool restr) const {
   uint32_t overflowCheck = c;
 
-  if (n && !n->pl().isTurnCycle()) {
-    if (_rOpts.fullTurnPunishFac != 0 && from->getFrom() == to->getTo() &&
-        from->getTo() == to->getFrom()) {
-      // trivial full turn
-      c += _rOpts.fullTurnPunishFac;
-
-      if (c <= overflowCheck) return std::numeric_limits<uint32_t>::max();
-      overflowCheck = c;
-    } else if (_rOpts.fullTurnPunishFac != 0 && n->getDeg() > 2) {
-      // otherwise, only intersection angles will be punished
-
-      double ang = util::geo::innerProd(
-          *n->pl().getGeom(), from->pl().backHop(), to->pl().frontHop());
-
-      if (ang < _rOpts.fullTurnAngle) {
-        c += _rOpts.fullTurnPunishFac;
-        if (c <= overflowCheck) return std::numeric_limits<uint32_t>::max();
-        overflowCheck = c;
-      }
-    }
+  if (fullTurn) {
+    c += _rOpts.fullTurnPunishFac;
+    if (c <= overflowCheck) return std::numeric_limits<uint32_t>::max();
+    overflowCheck = c;
+  }
 
-    // turn restriction cost
-    if (_rOpts.turnRestrCost > 0 && from->pl().isRestricted() &&
-        !_res.may(from, to, n)) {
-      c += _rOpts.turnRestrCost;
-      if (c <= overflowCheck) return std::numeric_limits<uint32_t>::max();
-    }
+  // turn restriction cost
+  if (restr) {
+    c += _rOpts.turnRestrCost;
+    if (c <= overflowCheck) return std::numeric_limits<uint32_t>::max();
   }
 
   return c;
@@ -180,6 +239,17 @@ double ExpoTransWeight::weight(uint32_t c, double d, double t0, double d0,
   return rOpts.transitionPen * static_cast<double>(c) / 10.0;
 }
 
+// _____________________________________________________________________________
+void ExpoTransWeight::weights(const uint32_t* c, const uint32_t* d,
+                              const double* t0, double d0,
+                              const RoutingOpts& rOpts, size_t n, double* w) {
+  UNUSED(d);
+  UNUSED(t0);
+  UNUSED(d0);
+  const double pen = rOpts.transitionPen;
+  for (size_t i = 0; i < n; i++) w[i] = pen * static_cast<double>(c[i]) / 10.0;
+}
+
 // _____________________________________________________________________________
 uint32_t ExpoTransWeight::invWeight(double c, const RoutingOpts& rOpts) {
   return std::round((c / rOpts.transitionPen) * 10.0);
@@ -222,6 +292,28 @@ double NormDistrTransWeight::weight(uint32_t cs, double d, double t0, double d0,
   return normWeight + expWeight;
 }
 
+// _____________________________________________________________________________
+void NormDistrTransWeight::weights(const uint32_t* c, const uint32_t* d,
+                                   const double* t0, double d0,
+                                   const RoutingOpts& rOpts, size_t n,
+                                   double* w) {
+  UNUSED(d);
+  UNUSED(d0);
+
+  const double pen = rOpts.transitionPen;
+  const double inf = std::numeric_limits<double>::infinity();
+
+  // same as weight(), but branch free
+  for (size_t i = 0; i < n; i++) {
+    const double cs = static_cast<double>(c[i]);
+    const double t = cs / 10.0;
+    const double tt = t0[i] > 10 ? t0[i] : 10;
+    const double cNorm = t / tt - 1;
+    const double ret = cNorm * cNorm + pen * cs / 10.0;
+    w[i] = t0[i] < 0 ? inf : ret;
+  }
+}
+
 // _____________________________________________________________________________
 uint32_t NormDistrTransWeight::invWeight(double c, const RoutingOpts& rOpts) {
   UNUSED(rOpts);
@@ -243,6 +335,19 @@ double DistDiffTransWeight::weight(uint32_t c, double d, double t0, double d0,
   return rOpts.transitionPen * w;
 }
 
+// _____________________________________________________________________________
+void DistDiffTransWeight::weights(const uint32_t* c, const uint32_t* d,
+                                  const double* t0, double d0,
+                                  const RoutingOpts& rOpts, size_t n,
+                                  double* w) {
+  UNUSED(c);
+  UNUSED(t0);
+  const double pen = rOpts.transitionPen;
+  for (size_t i = 0; i < n; i++) {
+    w[i] = pen * fabs(static_cast<double>(d[i]) - d0);
+  }
+}
+
 // _____________________________________________________________________________
 uint32_t DistDiffTransWeight::invWeight(double c, const RoutingOpts& rOpts) {
   UNUSED(rOpts);
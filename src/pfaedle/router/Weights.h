@@ -9,6 +9,7 @@
 #include "pfaedle/osm/Restrictor.h"
 #include "pfaedle/router/Misc.h"
 #include "pfaedle/router/RoutingAttrs.h"
+#include "pfaedle/trgraph/CSRGraph.h"
 #include "pfaedle/trgraph/Graph.h"
 #include "util/graph/EDijkstra.h"
 
@@ -52,9 +53,20 @@ class ExpoTransWeight {
 
     uint32_t operator()(const trgraph::Edge* from, const trgraph::Node* n,
                         const trgraph::Edge* to) const;
+
+    // same as above, for the turn from edge id from onto edge id to in g
+    uint32_t operator()(const trgraph::CSRGraph& g, uint32_t from,
+                        uint32_t to) const;
     uint32_t inf() const { return _inf; }
 
     LineSimilarity transitLineSimi(const trgraph::Edge* e) const;
+
+   private:
+    // apply the line similarity penalties of edge from to its base cost c
+    uint32_t lineCost(const trgraph::Edge* from, uint32_t c) const;
+
+    // add the full turn and turn restriction penalties to c
+    uint32_t turnCost(uint32_t c, bool fullTurn, bool restr) const;
   };
 
   struct DistHeur : RHeurFunc {
@@ -67,6 +79,7 @@ class ExpoTransWeight {
     double _maxCentD;
     uint32_t operator()(const trgraph::Edge* a,
                         const std::set<trgraph::Edge*>& b) const;
+    uint32_t operator()(const trgraph::CSRGraph& g, uint32_t a) const;
     mutable const trgraph::Edge* _lastE;
     mutable uint32_t _lastC = 0;
   };
@@ -74,6 +87,13 @@ class ExpoTransWeight {
   static uint32_t maxCost(double tTime, const RoutingOpts& rOpts);
   static double weight(uint32_t c, double d, double t0, double d0,
                        const RoutingOpts& rOpts);
+
+  // Weights of the n hops with costs c, distances d (only read if NEED_DIST)
+  // and scheduled travel times t0, written to w. Computed in a flat loop
+  // over the whole row, so the compiler can vectorize it.
+  static void weights(const uint32_t* c, const uint32_t* d, const double* t0,
+                      double d0, const RoutingOpts& rOpts, size_t n,
+                      double* w);
   static uint32_t invWeight(double cost, const RoutingOpts& rOpts);
   static const bool ALLOWS_FAST_ROUTE = true;
   static const bool NEED_DIST = false;
@@ -95,6 +115,12 @@ class ExpoTransWeightNoHeur : public ExpoTransWeight {
       UNUSED(b);
       return 0;
     }
+
+    uint32_t operator()(const trgraph::CSRGraph& g, uint32_t a) const {
+      UNUSED(g);
+      UNUSED(a);
+      return 0;
+    }
   };
 };
 
@@ -102,6 +128,9 @@ class NormDistrTransWeight : public ExpoTransWeight {
  public:
   static double weight(uint32_t c, double d, double t0, double d0,
                        const RoutingOpts& rOpts);
+  static void weights(const uint32_t* c, const uint32_t* d, const double* t0,
+                      double d0, const RoutingOpts& rOpts, size_t n,
+                      double* w);
   static uint32_t invWeight(double cost, const RoutingOpts& rOpts);
   static const bool ALLOWS_FAST_ROUTE = false;
   static const bool NEED_DIST = false;
@@ -123,6 +152,12 @@ class NormDistrTransWeightNoHeur : public NormDistrTransWeight {
       UNUSED(b);
       return 0;
     }
+
+    uint32_t operator()(const trgraph::CSRGraph& g, uint32_t a) const {
+      UNUSED(g);
+      UNUSED(a);
+      return 0;
+    }
   };
 };
 
@@ -131,6 +166,9 @@ class DistDiffTransWeight : public ExpoTransWeight {
   static uint32_t maxCost(double tTime, const RoutingOpts& rOpts);
   static double weight(uint32_t c, double d, double t0, double d0,
                        const RoutingOpts& rOpts);
+  static void weights(const uint32_t* c, const uint32_t* d, const double* t0,
+                      double d0, const RoutingOpts& rOpts, size_t n,
+                      double* w);
   static uint32_t invWeight(double cost, const RoutingOpts& rOpts);
   static const bool ALLOWS_FAST_ROUTE = false;
   static const bool NEED_DIST = true;
@@ -152,6 +190,12 @@ class DistDiffTransWeightNoHeur : public DistDiffTransWeight {
       UNUSED(b);
       return 0;
     }
+
+    uint32_t operator()(const trgraph::CSRGraph& g, uint32_t a) const {
+      UNUSED(g);
+      UNUSED(a);
+      return 0;
+    }
   };
 };
 
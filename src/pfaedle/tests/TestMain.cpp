@@ -1,7 +1,11 @@
 // Copyright 2020
 // Author: Patrick Brosi
 
+#include "pfaedle/osm/GraphSnapshot.h"
+#include "pfaedle/osm/OsmIdSet.h"
 #include "pfaedle/osm/Restrictor.h"
+#include "pfaedle/router/CandIdx.h"
+#include "util/Misc.h"
 #include "util/Test.h"
 
 #define private public
@@ -9,23 +13,33 @@
 #undef private
 #define private private
 
+#include "pfaedle/osm/OsmBuilder.h"
+
+using pfaedle::osm::OsmIdSet;
+using pfaedle::osm::osmid;
 using pfaedle::osm::Restrictor;
+using pfaedle::router::CandIdx;
 using pfaedle::router::CostMatrix;
+using pfaedle::router::DistDiffTransWeight;
 using pfaedle::router::EdgeCandGroup;
 using pfaedle::router::ExpoTransWeight;
 using pfaedle::router::LayerCostsDAG;
+using pfaedle::router::NormDistrTransWeight;
 using pfaedle::router::RouterImpl;
 using pfaedle::router::RoutingAttrs;
 using pfaedle::router::RoutingOpts;
 using util::approx;
 
+// exposes the protected graph construction stages of OsmBuilder
+class TestOsmBuilder : public pfaedle::osm::OsmBuilder {
+ public:
+  using pfaedle::osm::OsmBuilder::writeComps;
+};
+
 // _____________________________________________________________________________
 uint32_t cmGet(const CostMatrix& m, size_t i, size_t j) {
-  for (const auto& e : m) {
-    if (e.first.first == i && e.first.second == j) return e.second;
-  }
-
-  return -1;
+  if (i >= m.getRows() || j >= m.getCols()) return -1;
+  return m.get(i, j);
 }
 
 // _____________________________________________________________________________
@@ -74,7 +88,8 @@ int main(int argc, char** argv) {
 
     pfaedle::router::HopCache c;
 
-    router.hops(froms, tos, &costM, &dists, rAttrs, rOpts, restr, &c, maxTime);
+    router.hops(froms, tos, &costM, &dists, 0, rAttrs, rOpts, restr, &c,
+                maxTime, 0);
 
     TEST(cmGet(costM, 0, 0), ==, approx(10));
     TEST(cmGet(costM, 1, 0), ==, approx(6));
@@ -91,7 +106,8 @@ int main(int argc, char** argv) {
 
     pfaedle::router::HopCache c;
 
-    router.hops(froms, tos, &costM, &dists, rAttrs, rOpts, restr, &c, maxTime);
+    router.hops(froms, tos, &costM, &dists, 0, rAttrs, rOpts, restr, &c,
+                maxTime, 0);
 
     TEST(cmGet(costM, 0, 0), ==, approx(50 + 10));
     TEST(cmGet(costM, 1, 0), ==, approx(50 + 6));
@@ -108,7 +124,8 @@ int main(int argc, char** argv) {
 
     pfaedle::router::HopCache c;
 
-    router.hops(froms, tos, &costM, &dists, rAttrs, rOpts, restr, &c, maxTime);
+    router.hops(froms, tos, &costM, &dists, 0, rAttrs, rOpts, restr, &c,
+                maxTime, 0);
 
     TEST(cmGet(costM, 0, 0), ==, approx(5));
     TEST(cmGet(costM, 1, 0), ==, approx(2));
@@ -125,7 +142,98 @@ int main(int argc, char** argv) {
 
     pfaedle::router::HopCache c;
 
-    router.hops(froms, tos, &costM, &dists, rAttrs, rOpts, restr, &c, maxTime);
+    router.hops(froms, tos, &costM, &dists, 0, rAttrs, rOpts, restr, &c,
+                maxTime, 0);
+
+    TEST(cmGet(costM, 0, 0), ==, approx(90 + 5));
+    TEST(cmGet(costM, 1, 0), ==, approx(90 + 2));
+  }
+
+  // shared hop cache
+  {
+    pfaedle::router::HopCache shared;
+    pfaedle::router::HopCache c(&shared);
+
+    TEST(c.getShared(), ==, &shared);
+    TEST(shared.getShared(), ==, &shared);
+
+    c.setEx(eA, eC, 5);
+    shared.setMin(eB, eC, 50);
+
+    TEST(c.get(eA, eC).first, ==, 5);
+    TEST(c.get(eA, eC).second, ==, true);
+    TEST(c.get(eB, eC).second, ==, false);
+    TEST(shared.get(eB, eC).first, ==, 50);
+    TEST(shared.get(eB, eC).second, ==, false);
+    TEST(shared.get(eA, eC).first, ==, 0);
+
+    TEST(c.getNumLookups(), ==, 3);
+    TEST(c.getNumHits(), ==, 2);
+    TEST(shared.getNumLookups(), ==, 3);
+    TEST(shared.getNumHits(), ==, 0);
+  }
+
+  // on the CSR view of the graph
+  {
+    pfaedle::trgraph::CSRGraph csr(g);
+    RouterImpl<ExpoTransWeight> csrRouter(&csr);
+
+    EdgeCandGroup froms, tos;
+    CostMatrix costM, dists;
+    froms.push_back({eA, 0, 0.5, {}, 0, {}});
+    froms.push_back({eB, 0, 2.0 / 3.0, {}, 0, {}});
+    tos.push_back({eC, 0, 0.9, {}, 0, {}});
+
+    double maxTime = 9999;
+
+    pfaedle::router::HopCache c;
+
+    pfaedle::router::PathMatrix paths;
+
+    csrRouter.hops(froms, tos, &costM, &dists, &paths, rAttrs, rOpts, restr,
+                   &c, maxTime, 0);
+
+    TEST(csr.getNumNds(), ==, 4);
+    TEST(csr.getNumEdgs(), ==, 3);
+    TEST(cmGet(costM, 0, 0), ==, approx(90 + 5));
+    TEST(cmGet(costM, 1, 0), ==, approx(90 + 2));
+
+    // the hop paths are kept, target edge first
+    TEST(paths.size(), ==, 2);
+    TEST(paths[0]->size(), ==, 2);
+    TEST(paths[0]->front(), ==, eC);
+    TEST(paths[0]->back(), ==, eA);
+    TEST(paths[1]->back(), ==, eB);
+
+    // single pair search, from both sides
+    ExpoTransWeight::CostFunc pairCostF(rAttrs, rOpts, restr, 9999);
+    ExpoTransWeight::DistHeur toC(9999999, rOpts, {eC});
+    ExpoTransWeight::DistHeur frA(9999999, rOpts, {eA});
+    ExpoTransWeight::DistHeur toA(9999999, rOpts, {eA});
+    ExpoTransWeight::DistHeur frB(9999999, rOpts, {eB});
+    pfaedle::router::EdgeList edgs;
+
+    TEST(csrRouter.csrPath(eA, eC, pairCostF, toC, frA, &edgs), ==, 10);
+    TEST(edgs.size(), ==, 2);
+    TEST(edgs.front(), ==, eC);
+    TEST(edgs.back(), ==, eA);
+
+    edgs.clear();
+    TEST(csrRouter.csrPath(eB, eA, pairCostF, toA, frB, &edgs), ==, 9999);
+    TEST(edgs.size(), ==, 0);
+
+    edgs.clear();
+    TEST(csrRouter.csrPath(eC, eC, pairCostF, toC, toC, &edgs), ==, 0);
+    TEST(edgs.size(), ==, 1);
+
+    // with a contraction hierarchy
+    pfaedle::router::ContractionHierarchy ch(csr, rOpts, restr);
+    RouterImpl<ExpoTransWeight> chRouter(&csr, &ch);
+
+    pfaedle::router::HopCache chC;
+
+    chRouter.hops(froms, tos, &costM, &dists, 0, rAttrs, rOpts, restr, &chC,
+                  maxTime, 0);
 
     TEST(cmGet(costM, 0, 0), ==, approx(90 + 5));
     TEST(cmGet(costM, 1, 0), ==, approx(90 + 2));
@@ -306,5 +414,370 @@ int main(int argc, char** argv) {
     TEST(cmGet(costM, 2, 1), >=, maxTime);
   }
 
+  // beam pruning
+  {
+    EdgeCandGroup cands;
+    cands.push_back({eA, 0, 0, {}, 0, {}});
+    cands.push_back({eB, 0, 0, {}, 0, {}});
+    cands.push_back({0, 0, 0, {}, 0, {}});
+    cands.push_back({eC, 0, 0, {}, 0, {}});
+    cands.push_back({eB, 0, 0.5, {}, 0, {}});
+    LayerCostsDAG costs{30, 10, 5, 20, 10};
+
+    EdgeCandGroup beam;
+    double cut = 0;
+
+    TEST(router.beamPrune(cands, costs, 4, &beam, &cut), ==, 0);
+    TEST(cut, ==, std::numeric_limits<double>::infinity());
+
+    TEST(router.beamPrune(cands, costs, 2, &beam, &cut), ==, 2);
+    TEST(cut, ==, approx(20));
+    TEST(beam.size(), ==, 5);
+    TEST(beam[0].e, ==, 0);
+    TEST(beam[1].e, ==, eB);
+    TEST(beam[2].e, ==, 0);
+    TEST(beam[3].e, ==, 0);
+    TEST(beam[4].e, ==, eB);
+    TEST(beam[4].progr, ==, approx(0.5));
+  }
+
+  // batched transition weights
+  {
+    RoutingOpts wOpts;
+    wOpts.transitionPen = 3;
+    const uint32_t cs[5] = {0, 10, 250, 4000, 123456};
+    const uint32_t ds[5] = {0, 7, 900, 300, 50000};
+    const double ts[5] = {-5, 0, 20, 400, 9000};
+    double ws[5];
+
+    ExpoTransWeight::weights(cs, ds, ts, 500, wOpts, 5, ws);
+    for (size_t i = 0; i < 5; i++) {
+      TEST(ws[i], ==,
+           approx(ExpoTransWeight::weight(cs[i], ds[i], ts[i], 500, wOpts)));
+    }
+
+    NormDistrTransWeight::weights(cs, ds, ts, 500, wOpts, 5, ws);
+    TEST(ws[0], ==, std::numeric_limits<double>::infinity());
+    for (size_t i = 1; i < 5; i++) {
+      TEST(ws[i], ==, approx(NormDistrTransWeight::weight(cs[i], ds[i], ts[i],
+                                                          500, wOpts)));
+    }
+
+    DistDiffTransWeight::weights(cs, ds, ts, 500, wOpts, 5, ws);
+    for (size_t i = 0; i < 5; i++) {
+      TEST(ws[i], ==, approx(DistDiffTransWeight::weight(cs[i], ds[i], ts[i],
+                                                         500, wOpts)));
+    }
+  }
+
+  // candidate index
+  {
+    CandIdx<int> idx;
+    std::vector<std::pair<int, double>> res;
+
+    idx.build();
+    idx.get(POINT(0, 0), 100, &res);
+    TEST(res.size(), ==, 0);
+
+    idx.add(LINE{{0, 0}, {10, 0}, {10, 10}}, 1);
+    idx.add(LINE{{0, 5}, {5, 5}}, 2);
+    idx.add(POINT(3, 1), 3);
+    // many far away values, to get more than one level
+    for (int i = 0; i < 1000; i++) {
+      idx.add(LINE{{100.0 + i, 100}, {100.0 + i, 101}}, 100 + i);
+    }
+    idx.build();
+    TEST(idx.size(), ==, 1003);
+
+    idx.get(POINT(3, 2), 4, &res);
+    TEST(res.size(), ==, 3);
+    TEST(res[0].first, ==, 3);
+    TEST(res[0].second, ==, approx(1));
+    TEST(res[1].first, ==, 1);
+    TEST(res[1].second, ==, approx(2));
+    TEST(res[2].first, ==, 2);
+    TEST(res[2].second, ==, approx(3));
+
+    // the nearest segment of a value determines its distance
+    res.clear();
+    idx.get(POINT(11, 5), 2, &res);
+    TEST(res.size(), ==, 1);
+    TEST(res[0].first, ==, 1);
+    TEST(res[0].second, ==, approx(1));
+
+    res.clear();
+    idx.get(POINT(100.5, 99), 1.2, &res);
+    TEST(res.size(), ==, 2);
+    TEST(res[0].second, ==, approx(std::sqrt(1.25)));
+    TEST(res[1].second, ==, approx(std::sqrt(1.25)));
+
+    res.clear();
+    idx.get(POINT(50, 50), 10, &res);
+    TEST(res.size(), ==, 0);
+
+    // batched lookup
+    std::vector<std::vector<std::pair<int, double>>> rets;
+    idx.get({POINT(3, 2), POINT(11, 5), POINT(50, 50)}, {4, 2, 10}, &rets);
+    TEST(rets.size(), ==, 3);
+    TEST(rets[0].size(), ==, 3);
+    TEST(rets[0][0].first, ==, 3);
+    TEST(rets[0][1].first, ==, 1);
+    TEST(rets[0][2].first, ==, 2);
+    TEST(rets[0][2].second, ==, approx(3));
+    TEST(rets[1].size(), ==, 1);
+    TEST(rets[1][0].second, ==, approx(1));
+    TEST(rets[2].size(), ==, 0);
+
+    // the curve covers the 16x16 cells at the origin first, and
+    // consecutive positions on it are neighbors
+    std::vector<std::pair<uint32_t, uint32_t>> curve(256, {99, 99});
+    for (uint32_t x = 0; x < 16; x++) {
+      for (uint32_t y = 0; y < 16; y++) {
+        uint64_t d = pfaedle::router::hilbertIdx(x, y);
+        TEST(d, <, 256);
+        curve[d] = {x, y};
+      }
+    }
+    TEST(curve[0].first, ==, 0);
+    TEST(curve[0].second, ==, 0);
+    for (size_t d = 1; d < 256; d++) {
+      int dx = std::abs(static_cast<int>(curve[d].first) -
+                        static_cast<int>(curve[d - 1].first));
+      int dy = std::abs(static_cast<int>(curve[d].second) -
+                        static_cast<int>(curve[d - 1].second));
+      TEST(dx + dy, ==, 1);
+    }
+  }
+
+  {
+    OsmIdSet sorted(pfaedle::osm::ID_SET_MEM);
+    OsmIdSet unsorted(pfaedle::osm::ID_SET_MEM);
+
+    for (osmid i = 1; i < 100000; i++) {
+      sorted.add(i * 7);
+      sorted.add(i * 7);
+      unsorted.add(((i * 7919) % 100000) * 7);
+      unsorted.nadd(i * 7 + 1);
+    }
+
+    TEST(sorted.has(0), ==, false);
+    TEST(unsorted.has(0), ==, false);
+    TEST(sorted.has(7), ==, true);
+    TEST(sorted.has(8), ==, false);
+    TEST(sorted.has(699993), ==, true);
+    TEST(sorted.has(700000), ==, false);
+
+    for (osmid i = 1; i < 100000; i += 97) {
+      TEST(sorted.has(i * 7), ==, true);
+      TEST(unsorted.has(i * 7), ==, true);
+      TEST(sorted.has(i * 7 + 3), ==, false);
+      TEST(unsorted.has(i * 7 + 3), ==, false);
+    }
+  }
+
+  // external sort of disk-based sets, with the minimal run and merge buffer
+  // sizes: 4 runs, each merge buffer is refilled 16 times
+  {
+    pfaedle::ThreadPool pool(2);
+    OsmIdSet pooled(pfaedle::osm::ID_SET_DISK, 0, &pool);
+    OsmIdSet unpooled(pfaedle::osm::ID_SET_DISK, 0);
+
+    // every id is added twice, 200000 positions (more than a run) apart
+    for (osmid i = 0; i < 400000; i++) {
+      pooled.add(((i * 7919) % 200000) * 2 + 2);
+      unpooled.add(((i * 7919) % 200000) * 2 + 2);
+    }
+
+    TEST(pooled.has(0), ==, false);
+    TEST(pooled.has(2), ==, true);
+    TEST(pooled.has(400000), ==, true);
+    TEST(pooled.has(400002), ==, false);
+    TEST(unpooled.has(2), ==, true);
+    TEST(unpooled.has(400000), ==, true);
+
+    for (osmid i = 1; i <= 200000; i++) {
+      TEST(pooled.has(i * 2), ==, true);
+      TEST(pooled.has(i * 2 + 1), ==, false);
+      TEST(unpooled.has(i * 2), ==, true);
+      TEST(unpooled.has(i * 2 - 1), ==, false);
+    }
+  }
+
+  // graph snapshot round trip
+  {
+    using pfaedle::trgraph::Edge;
+    using pfaedle::trgraph::Graph;
+    using pfaedle::trgraph::Node;
+
+    Graph sg;
+    auto sa = sg.addNd(POINT{0, 0});
+    auto sb = sg.addNd(POINT{10, 0});
+    auto sc = sg.addNd(POINT{20, 0});
+    auto sd = sg.addNd(POINT{10, 10});
+    auto se = sg.addNd(POINT{10, -10});
+
+    sb->pl().setSI(pfaedle::trgraph::StatInfo("B", "1"));
+    sd->pl().setBlocker();
+    for (auto* n : sg.getNds()) n->pl().setComp(0);
+
+    pfaedle::trgraph::TransitEdgeLine line{"X", "Y", "1", 0xff0000};
+    std::vector<Edge*> edgs;
+    for (auto* n : {sa, sc, sd, se}) {
+      edgs.push_back(sg.addEdg(n, sb));
+      edgs.push_back(sg.addEdg(sb, n));
+    }
+    auto cc = sg.addEdg(sc, sc);
+    edgs.push_back(cc);
+    for (size_t i = 0; i < edgs.size(); i++) {
+      edgs[i]->pl().setCost(i * 10);
+      edgs[i]->pl().setLvl(i % 8);
+      edgs[i]->pl().setOneWay(i % 3);
+      edgs[i]->pl().addPoint(*edgs[i]->getFrom()->pl().getGeom());
+      edgs[i]->pl().addPoint(*edgs[i]->getTo()->pl().getGeom());
+    }
+    edgs[0]->pl().addLine(&line);
+
+    // edges which are no longer part of the graph
+    Graph removed;
+    auto gone = removed.addEdg(removed.addNd(POINT{0, 0}),
+                               removed.addNd(POINT{1, 1}));
+
+    auto ab = sg.getEdg(sa, sb), bc = sg.getEdg(sb, sc);
+    auto cb = sg.getEdg(sc, sb), bd = sg.getEdg(sb, sd);
+    auto db = sg.getEdg(sd, sb), be = sg.getEdg(sb, se);
+    auto eb = sg.getEdg(se, sb);
+
+    Restrictor sres;
+    sres.addRule(ab, bc, sb, true);
+    // forbids every other turn from db, the second rule is unreachable
+    sres.addRule(db, gone, sb, true);
+    sres.addRule(db, be, sb, true);
+    sres.addRule(eb, 0, sb, true);
+    sres.addRule(cb, bd, sb, false);
+    sres.addRule(cb, gone, sb, false);
+    sres.addRule(gone, bc, sb, false);
+    sres.addRule(bc, gone, sc, true);
+
+    TEST(sres.may(db, bc, sb), ==, false);
+    TEST(sres.may(bc, cc, sc), ==, false);
+
+    std::string path = util::getTmpFName("<tmp>", ".pfaedle-test", "");
+    pfaedle::osm::GraphSnapshot::write(path, 42, sg, sres);
+
+    Graph lg;
+    Restrictor lres;
+    std::vector<pfaedle::trgraph::TransitEdgeLine*> lines;
+    TEST(pfaedle::osm::GraphSnapshot::read(path, 43, &lg, &lres, &lines), ==,
+         false);
+    TEST(lg.getNds().size(), ==, 0);
+    TEST(pfaedle::osm::GraphSnapshot::read(path, 42, &lg, &lres, &lines), ==,
+         true);
+    unlink(path.c_str());
+
+    TEST(lines.size(), ==, 1);
+    TEST(lines[0]->shortName, ==, "1");
+    TEST(lines[0]->color, ==, 0xff0000);
+
+    // the nodes are matched by their positions
+    std::map<const Node*, Node*> nds;
+    TEST(lg.getNds().size(), ==, sg.getNds().size());
+    for (auto* n : sg.getNds()) {
+      for (auto* m : lg.getNds()) {
+        if (util::geo::dist(*n->pl().getGeom(), *m->pl().getGeom()) < 0.01) {
+          nds[n] = m;
+        }
+      }
+      TEST(nds.count(n), ==, 1);
+      TEST(nds[n]->pl().getCompId(), ==, n->pl().getCompId());
+      TEST(nds[n]->pl().isBlocker(), ==, n->pl().isBlocker());
+      TEST(nds[n]->getAdjListOut().size(), ==, n->getAdjListOut().size());
+      TEST(nds[n]->getAdjListIn().size(), ==, n->getAdjListIn().size());
+    }
+    TEST(nds[sb]->pl().getSI()->getName(), ==, "B");
+    TEST(nds[sb]->pl().getSI()->getTrack(), ==, "1");
+    TEST(nds[sa]->pl().getSI(), ==, 0);
+
+    std::map<const Edge*, const Edge*> eds;
+    for (auto* e : edgs) {
+      const Edge* f = lg.getEdg(nds[e->getFrom()], nds[e->getTo()]);
+      TEST(f, !=, 0);
+      eds[e] = f;
+      TEST(f->pl().getCost(), ==, e->pl().getCost());
+      TEST(f->pl().lvl(), ==, e->pl().lvl());
+      TEST(f->pl().oneWay(), ==, e->pl().oneWay());
+      TEST(f->pl().getGeom()->size(), ==, e->pl().getGeom()->size());
+      TEST(f->pl().getLines().size(), ==, e->pl().getLines().size());
+    }
+    TEST(eds[edgs[0]]->pl().getLines()[0], ==, lines[0]);
+
+    // every turn is allowed or forbidden as before
+    for (auto* via : sg.getNds()) {
+      for (auto* from : via->getAdjListIn()) {
+        for (auto* to : via->getAdjListOut()) {
+          TEST(lres.may(eds[from], eds[to], nds[via]), ==,
+               sres.may(from, to, via));
+        }
+      }
+    }
+    TEST(lres.may(eds[ab], eds[bd], nds[sb]), ==, false);
+    TEST(lres.may(eds[db], eds[be], nds[sb]), ==, false);
+    TEST(lres.may(eds[eb], eds[bd], nds[sb]), ==, true);
+    TEST(lres.may(eds[cb], eds[bd], nds[sb]), ==, false);
+    TEST(lres.may(eds[cb], eds[be], nds[sb]), ==, true);
+    TEST(lres.may(eds[bc], eds[cc], nds[sc]), ==, false);
+  }
+
+  // graph components
+  {
+    pfaedle::osm::OsmReadOpts opts;
+    opts.maxSpeedCorFac = 2;
+    for (size_t i = 0; i < 8; i++) opts.levelDefSpeed[i] = (i + 1) * 10;
+
+    pfaedle::trgraph::Graph cg;
+    auto a1 = cg.addNd(POINT{0, 0});
+    auto a2 = cg.addNd(POINT{1, 0});
+    auto a3 = cg.addNd(POINT{2, 0});
+    auto b1 = cg.addNd(POINT{0, 1});
+    auto b2 = cg.addNd(POINT{1, 1});
+    auto i1 = cg.addNd(POINT{0, 2});
+    auto i2 = cg.addNd(POINT{1, 2});
+    auto s = cg.addNd(POINT{2, 2});
+
+    // a2 is only reachable via one-way edges
+    cg.addEdg(a1, a2)->pl().setLvl(0);
+    cg.addEdg(a3, a2)->pl().setLvl(2);
+    cg.addEdg(b1, b2)->pl().setLvl(5);
+    cg.addEdg(b2, b1)->pl().setLvl(5);
+    cg.addEdg(s, s)->pl().setLvl(7);
+
+    pfaedle::ThreadPool pool(2);
+    for (auto* p : {&pool, static_cast<pfaedle::ThreadPool*>(0)}) {
+      for (auto* n : cg.getNds()) n->pl().setComp(0);
+
+      TEST(TestOsmBuilder::writeComps(&cg, opts, p), ==, 2);
+
+      std::set<uint32_t> ids;
+      for (auto* n : cg.getNds()) {
+        TEST(n->pl().getCompId(), >, 0);
+        TEST(n->pl().getCompId(), <, pfaedle::trgraph::NodePL::comps.size());
+        ids.insert(n->pl().getCompId());
+      }
+      TEST(ids.size(), ==, 5);
+      TEST(pfaedle::trgraph::NodePL::comps.size(), ==, 6);
+
+      TEST(a1->pl().getCompId(), ==, a2->pl().getCompId());
+      TEST(a3->pl().getCompId(), ==, a2->pl().getCompId());
+      TEST(b1->pl().getCompId(), ==, b2->pl().getCompId());
+      TEST(b1->pl().getCompId(), !=, a1->pl().getCompId());
+      TEST(i1->pl().getCompId(), !=, i2->pl().getCompId());
+
+      TEST(a1->pl().getComp().maxSpeed, ==, approx(15));
+      TEST(b2->pl().getComp().maxSpeed, ==, approx(30));
+      TEST(i1->pl().getComp().maxSpeed, ==, approx(0));
+      TEST(i2->pl().getComp().maxSpeed, ==, approx(0));
+      TEST(s->pl().getComp().maxSpeed, ==, approx(40));
+    }
+  }
+
   exit(0);
 }
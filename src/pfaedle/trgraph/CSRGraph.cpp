@@ -0,0 +1,115 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#include <stdexcept>
+#include "pfaedle/trgraph/CSRGraph.h"
+#include "util/log/Log.h"
+
+using pfaedle::trgraph::CSRGraph;
+using pfaedle::trgraph::Edge;
+using pfaedle::trgraph::Graph;
+using pfaedle::trgraph::Node;
+
+const uint32_t CSRGraph::NO_ID;
+
+// _____________________________________________________________________________
+CSRGraph::CSRGraph(const Graph& g) {
+  size_t numEdgs = 0;
+  for (const Node* n : g.getNds()) numEdgs += n->getAdjListOut().size();
+
+  if (g.getNds().size() >= NO_ID || numEdgs >= NO_ID)
+    throw std::runtime_error("Graph too large for CSR view.");
+
+  _nds.reserve(g.getNds().size());
+  _ndIds.reserve(g.getNds().size());
+  for (const Node* n : g.getNds()) {
+    _ndIds[n] = _nds.size();
+    _nds.push_back(n);
+  }
+
+  _outOffs.reserve(_nds.size() + 1);
+  _ndComp.reserve(_nds.size());
+  _ndDeg.reserve(_nds.size());
+  _ndTurnCycle.reserve(_nds.size());
+  _ndGeom.reserve(_nds.size());
+
+  _edgs.reserve(numEdgs);
+  _edgIds.reserve(numEdgs);
+  _edgFrom.reserve(numEdgs);
+  _edgTo.reserve(numEdgs);
+  _edgCost.reserve(numEdgs);
+  _edgFlags.reserve(numEdgs);
+  _edgLen.reserve(numEdgs);
+  _edgBackHop.reserve(numEdgs);
+  _edgFrontHop.reserve(numEdgs);
+
+  for (uint32_t nid = 0; nid < _nds.size(); nid++) {
+    const Node* n = _nds[nid];
+    _outOffs.push_back(_edgs.size());
+
+    _ndComp.push_back(n->pl().getCompId());
+    _ndDeg.push_back(n->getDeg());
+    _ndTurnCycle.push_back(n->pl().isTurnCycle());
+    _ndGeom.push_back(*n->pl().getGeom());
+
+    for (const Edge* e : n->getAdjListOut()) {
+      _edgIds[e] = _edgs.size();
+      _edgs.push_back(e);
+      _edgFrom.push_back(nid);
+      _edgTo.push_back(_ndIds.find(e->getTo())->second);
+      _edgCost.push_back(e->pl().getCost());
+      _edgFlags.push_back((e->pl().lvl() & 15) | ((e->pl().oneWay() & 3) << 4) |
+                          (e->pl().isRestricted() << 6));
+
+      if (e->pl().getGeom() && e->pl().getGeom()->size() > 1) {
+        _edgLen.push_back(e->pl().getLength());
+        _edgBackHop.push_back(e->pl().backHop());
+        _edgFrontHop.push_back(e->pl().frontHop());
+      } else {
+        _edgLen.push_back(0);
+        _edgBackHop.push_back(*n->pl().getGeom());
+        _edgFrontHop.push_back(*e->getTo()->pl().getGeom());
+      }
+    }
+  }
+
+  _outOffs.push_back(_edgs.size());
+
+  // index the incoming edges
+  _inOffs.assign(_nds.size() + 1, 0);
+  for (uint32_t e = 0; e < _edgs.size(); e++) _inOffs[_edgTo[e] + 1]++;
+  for (uint32_t n = 0; n < _nds.size(); n++) _inOffs[n + 1] += _inOffs[n];
+
+  _inEdgs.resize(_edgs.size());
+  std::vector<uint32_t> pos(_inOffs.begin(), _inOffs.end() - 1);
+  for (uint32_t e = 0; e < _edgs.size(); e++) _inEdgs[pos[_edgTo[e]]++] = e;
+
+  LOG(DEBUG) << "Built CSR view with " << _nds.size() << " nodes and "
+             << _edgs.size() << " edges, "
+             << getMemSize() / (1024 * 1024) << " MB";
+}
+
+// _____________________________________________________________________________
+uint32_t CSRGraph::getId(const Edge* e) const {
+  auto i = _edgIds.find(e);
+  if (i == _edgIds.end()) return NO_ID;
+  return i->second;
+}
+
+// _____________________________________________________________________________
+uint32_t CSRGraph::getId(const Node* n) const {
+  auto i = _ndIds.find(n);
+  if (i == _ndIds.end()) return NO_ID;
+  return i->second;
+}
+
+// _____________________________________________________________________________
+size_t CSRGraph::getMemSize() const {
+  return (_outOffs.size() + _inOffs.size() + _inEdgs.size()) *
+             sizeof(uint32_t) +
+         _nds.size() * (2 * sizeof(uint32_t) + sizeof(uint8_t) +
+                        sizeof(POINT) + sizeof(Node*)) +
+         _edgs.size() * (3 * sizeof(uint32_t) + sizeof(uint8_t) +
+                         sizeof(double) + 2 * sizeof(POINT) + sizeof(Edge*)) +
+         (_ndIds.size() + _edgIds.size()) * 4 * sizeof(void*);
+}
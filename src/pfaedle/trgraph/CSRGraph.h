@@ -0,0 +1,107 @@
+// Copyright 2026
+// Author: agent <agent@local>
+
+#ifndef PFAEDLE_TRGRAPH_CSRGRAPH_H_
+#define PFAEDLE_TRGRAPH_CSRGRAPH_H_
+
+#include <stdint.h>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "pfaedle/Def.h"
+#include "pfaedle/trgraph/Graph.h"
+
+namespace pfaedle {
+namespace trgraph {
+
+/*
+ * Frozen, read-only compressed sparse row view of a finished transit graph.
+ * Edges are numbered consecutively and grouped by their source node, so the
+ * outgoing edges of node n are the ids [outBeg(n), outEnd(n)). The ids of
+ * the incoming edges of n are getInEdg(k) for k in [inBeg(n), inEnd(n)).
+ * Everything the router touches while relaxing an edge is held in flat
+ * arrays; the edge geometries and transit lines stay in the original graph
+ * and are reached via getEdg().
+ *
+ * The view must be rebuilt if the underlying graph is changed.
+ */
+class CSRGraph {
+ public:
+  explicit CSRGraph(const Graph& g);
+
+  static const uint32_t NO_ID = std::numeric_limits<uint32_t>::max();
+
+  size_t getNumNds() const { return _nds.size(); }
+  size_t getNumEdgs() const { return _edgs.size(); }
+
+  // Return the id of edge e, or NO_ID if e is not part of the view
+  uint32_t getId(const Edge* e) const;
+
+  // Return the id of node n, or NO_ID if n is not part of the view
+  uint32_t getId(const Node* n) const;
+
+  const Edge* getEdg(uint32_t e) const { return _edgs[e]; }
+  const Node* getNd(uint32_t n) const { return _nds[n]; }
+
+  uint32_t outBeg(uint32_t n) const { return _outOffs[n]; }
+  uint32_t outEnd(uint32_t n) const { return _outOffs[n + 1]; }
+
+  uint32_t inBeg(uint32_t n) const { return _inOffs[n]; }
+  uint32_t inEnd(uint32_t n) const { return _inOffs[n + 1]; }
+  uint32_t getInEdg(uint32_t k) const { return _inEdgs[k]; }
+
+  uint32_t getFrom(uint32_t e) const { return _edgFrom[e]; }
+  uint32_t getTo(uint32_t e) const { return _edgTo[e]; }
+
+  // costs in 1/10th seconds
+  uint32_t getCost(uint32_t e) const { return _edgCost[e]; }
+  double getLength(uint32_t e) const { return _edgLen[e]; }
+
+  uint8_t getLvl(uint32_t e) const { return _edgFlags[e] & 15; }
+  uint8_t oneWay(uint32_t e) const { return (_edgFlags[e] >> 4) & 3; }
+  bool isRestricted(uint32_t e) const { return _edgFlags[e] & 64; }
+
+  const POINT& backHop(uint32_t e) const { return _edgBackHop[e]; }
+  const POINT& frontHop(uint32_t e) const { return _edgFrontHop[e]; }
+
+  uint32_t getCompId(uint32_t n) const { return _ndComp[n]; }
+  uint32_t getDeg(uint32_t n) const { return _ndDeg[n]; }
+  bool isTurnCycle(uint32_t n) const { return _ndTurnCycle[n]; }
+  const POINT& getGeom(uint32_t n) const { return _ndGeom[n]; }
+
+  // Approximate memory consumption in bytes
+  size_t getMemSize() const;
+
+ private:
+  // per node, size getNumNds() + 1
+  std::vector<uint32_t> _outOffs;
+  std::vector<uint32_t> _inOffs;
+
+  // edge ids, grouped by target node
+  std::vector<uint32_t> _inEdgs;
+
+  // per node
+  std::vector<uint32_t> _ndComp;
+  std::vector<uint32_t> _ndDeg;
+  std::vector<uint8_t> _ndTurnCycle;
+  std::vector<POINT> _ndGeom;
+
+  // per edge
+  std::vector<uint32_t> _edgFrom;
+  std::vector<uint32_t> _edgTo;
+  std::vector<uint32_t> _edgCost;
+  std::vector<uint8_t> _edgFlags;
+  std::vector<double> _edgLen;
+  std::vector<POINT> _edgBackHop;
+  std::vector<POINT> _edgFrontHop;
+
+  // mapping back to the original graph
+  std::vector<const Node*> _nds;
+  std::vector<const Edge*> _edgs;
+  std::unordered_map<const Node*, uint32_t> _ndIds;
+  std::unordered_map<const Edge*, uint32_t> _edgIds;
+};
+}  // namespace trgraph
+}  // namespace pfaedle
+
+#endif  // PFAEDLE_TRGRAPH_CSRGRAPH_H_
@@ -62,6 +62,11 @@ bool Normalizer::operator==(const Normalizer& b) const {
   return _rulesOrig == b._rulesOrig;
 }
 
+// _____________________________________________________________________________
+const pfaedle::trgraph::ReplRules& Normalizer::getRules() const {
+  return _rulesOrig;
+}
+
 // _____________________________________________________________________________
 void Normalizer::buildRules(const ReplRules& rules) {
   for (auto rule : rules) {
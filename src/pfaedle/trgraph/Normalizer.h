@@ -39,6 +39,9 @@ class Normalizer {
 
   bool operator==(const Normalizer& b) const;
 
+  // Return the (uncompiled) replacement rules
+  const ReplRules& getRules() const;
+
  private:
   ReplRulesComp _rules;
   ReplRules _rulesOrig;